@@ -129,6 +129,11 @@ VALHALLA_URL = 'https://valhalla1.openstreetmap.de'
 # API and HTTP settings
 HTTP_TIMEOUT = timedelta(seconds=20)
 POSTGRES_STATEMENT_TIMEOUT = timedelta(seconds=30)
+POSTGRES_POOL_MAX_SIZE = 100  # per server, for requests and for background tasks
+POSTGRES_POOL_MAX_IDLE = timedelta(minutes=2)
+POSTGRES_REPLICA_URLS = ''  # space-separated, for db(replica=True) reads
+POSTGRES_REPLICA_POLL_INTERVAL = 0.2  # in seconds
+POSTGRES_REPLICA_MAX_LAG = timedelta(seconds=5)  # lagging replicas are not read from
 URLSAFE_BLACKLIST = '/;.,?%#'
 XML_PARSE_MAX_SIZE = _ByteSize('50 MiB')  # the same as CGImap
 REQUEST_TARGET_MAX_BYTES = 8192
@@ -145,7 +150,8 @@ COMPRESS_REPLICATION_GZIP_THREADS: int | float = 0.5
 CORS_MAX_AGE = timedelta(days=1)
 HSTS_MAX_AGE = timedelta(days=365)
 RATE_LIMIT_OPTIMISTIC_BLACKLIST_EXPIRE = timedelta(minutes=10)
-RATE_LIMIT_CLEANUP_PROBABILITY = 0.0001
+RATE_LIMIT_SYNC_INTERVAL = timedelta(seconds=1)
+RATE_LIMIT_CLEANUP_PROBABILITY = 0.005  # per sync
 TRUSTED_HOSTS_EXTRA = ''
 
 # -------------------- Authentication and User --------------------
@@ -300,6 +306,17 @@ REPORT_COMMENTS_PAGE_SIZE = 15
 # Search and Query
 MAP_QUERY_AREA_MAX_SIZE = 0.25  # in square degrees
 MAP_QUERY_LEGACY_NODES_LIMIT = 50_000
+MAP_QUERY_SINGLE_STATEMENT = True  # compute the map closure in one round-trip
+MAP_QUERY_STREAM_BATCH_SIZE = 1000  # rows per network read
+MAP_QUERY_CACHE_TILE_ZOOM = 16
+MAP_QUERY_CACHE_MAX_TILES = 2048  # per process, 0 to disable
+MAP_QUERY_CACHE_MAX_SIZE = _ByteSize('512 MiB')  # per process, estimated
+MAP_QUERY_CACHE_DENSE_EXPIRE = timedelta(minutes=10)  # tiles over the nodes limit
+MAP_QUERY_CACHE_MAX_BBOX_TILES = 16  # larger bboxes bypass the cache
+MAP_QUERY_CACHE_SYNC_LIMIT = 10_000  # more changes clear the whole cache
+NODE_LOCATION_STORE_PATH: Path | None = None  # e.g. data/node_locations.bin
+NODE_LOCATION_STORE_SYNC_BATCH = 1_000_000  # sequence_ids per sync query
+NODE_LOCATION_STORE_SYNC_INTERVAL = 5.0  # in seconds
 SEARCH_LOCAL_AREA_LIMIT = 100.0  # in square degrees
 SEARCH_LOCAL_MAX_ITERATIONS = 7
 SEARCH_LOCAL_RATIO = 0.5  # [0 - 1], smaller = more locality
@@ -312,6 +329,8 @@ NEARBY_USERS_RADIUS_METERS = 50_000.0
 TRACE_FILE_DECOMPRESSED_MAX_SIZE = _ByteSize('80 MiB')
 TRACE_FILE_ARCHIVE_MAX_FILES = 10
 TRACE_FILE_MAX_LAYERS = 2
+TRACE_FILE_EXTRACT_WORKERS = 4  # per process
+TRACE_FILE_EXTRACT_MEMORY_BUDGET = _ByteSize('256 MiB')  # per process, in-flight files
 TRACE_FILE_COMPRESS_ZSTD_THREADS = 4
 TRACE_FILE_COMPRESS_ZSTD_LEVEL = 6
 TRACE_POINT_QUERY_AREA_MAX_SIZE = 0.25  # in square degrees
@@ -435,6 +454,11 @@ CRYPTO_HASH_CACHE_SIZE_LIMIT = 2048
 FILE_CACHE_LOCK_TIMEOUT = timedelta(seconds=15)
 FILE_CACHE_MEMORY_MAX_ENTRIES = 1024
 FILE_CACHE_MEMORY_MAX_VALUE_SIZE = _ByteSize('256 KiB')
+FILE_CACHE_SHARED_MEMORY_PATH = Path('/dev/shm/openstreetmap-ng-file-cache')
+FILE_CACHE_SHARED_MEMORY_SIZE = _ByteSize('0 B')  # per host, 0 to disable
+FILE_CACHE_SHARED_MEMORY_MAX_VALUE_SIZE = _ByteSize('64 KiB')
+USER_DISPLAY_CACHE_EXPIRE = timedelta(seconds=30)
+USER_DISPLAY_CACHE_MAX_ENTRIES = 10_000  # per process, 0 to disable
 
 # External service caches
 DNS_CACHE_EXPIRE = timedelta(minutes=10)
@@ -12,7 +12,9 @@ from app.format import Format06
 from app.lib.auth.context import api_user
 from app.lib.geo.parse import parse_bbox
 from app.lib.io.xml_body import xml_body
+from app.lib.render import format_style
 from app.lib.time.date_utils import parse_date
+from app.middlewares.request_body_middleware import request_body_stream
 from app.models.db.changeset_comment import changeset_comments_resolve_rich_text
 from app.models.db.user import User
 from app.models.types import ChangesetId, UserId
@@ -89,7 +91,13 @@ async def download_changeset(
         )
         tg.create_task(UserQuery.resolve_elements_users(elements))
 
-    return Format06.encode_osmchange(elements)
+    if format_style.is_json():
+        return Format06.encode_osmchange(elements)
+
+    head, tail = OSMChangeResponse.xml_envelope()
+    return OSMChangeResponse.xml_response(
+        Format06.encode_elements_xml(elements, osmchange=True, head=head, tail=tail)
+    )
 
 
 @router.put('/changeset/{changeset_id:int}')
@@ -118,14 +126,12 @@ async def update_changeset(
 @router.post('/changeset/{changeset_id:int}/upload', response_class=DiffResultResponse)
 async def upload_diff(
     changeset_id: ChangesetId,
-    data: Annotated[list, xml_body('osmChange')],
     _: Annotated[User, api_user('write_api')],
 ):
-    try:
-        elements = Format06.decode_osmchange(changeset_id, data)
-    except Exception as e:
-        raise_for.bad_xml('osmChange', str(e))
-
+    # Decode the body as it arrives, so only the decoded elements are kept in memory
+    elements = await Format06.decode_osmchange_aiter(
+        changeset_id, request_body_stream()
+    )
     assigned_ref_map = await OptimisticDiff.run(elements)
     return Format06.encode_diff_result(assigned_ref_map)
 
@@ -2,6 +2,7 @@ from asyncio import TaskGroup
 from typing import Annotated
 
 from fastapi import APIRouter, File, Form, Query, Response, UploadFile
+from fastapi.responses import StreamingResponse
 from pydantic import NonNegativeInt
 from starlette import status
 
@@ -107,9 +108,9 @@ async def get_trace_gpx(
 async def download_trace(
     trace_id: TraceId,
 ):
-    content = await TraceQuery.get_one_data_by_id(trace_id)
-    return Response(
-        content=content,
+    chunks = await TraceQuery.stream_one_data_by_id(trace_id)
+    return StreamingResponse(
+        chunks,
         # Intentionally not using trace.name here.
         # It's unsafe and difficult to make right, removing in API 0.7
         headers={'Content-Disposition': f'attachment; filename="{trace_id}"'},
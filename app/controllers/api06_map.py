@@ -1,4 +1,6 @@
-from typing import Annotated
+from collections.abc import AsyncIterator, Callable
+from contextlib import aclosing
+from typing import Annotated, Any
 
 from fastapi import APIRouter, Query
 
@@ -6,9 +8,11 @@ from app.config import MAP_QUERY_AREA_MAX_SIZE, MAP_QUERY_LEGACY_NODES_LIMIT
 from app.exceptions.context import raise_for
 from app.format import Format06
 from app.lib.geo.parse import parse_bbox
-from app.lib.io.xml_codec import get_xattr
-from app.queries.element_query import ElementQuery
+from app.lib.render import format_style
+from app.models.db.element import Element
+from app.queries.element_map_query import ElementMapQuery
 from app.queries.user_query import UserQuery
+from app.responses.osm import OSMResponse
 
 router = APIRouter(prefix='/api/0.6')
 
@@ -21,22 +25,56 @@ async def get_map(bbox: Annotated[str, Query()]):
     if geometry.area > MAP_QUERY_AREA_MAX_SIZE:
         raise_for.map_query_area_too_big()
 
-    elements = await ElementQuery.find_by_geom(
+    chunks = ElementMapQuery.iter_by_geom(
         geometry,
         nodes_limit=MAP_QUERY_LEGACY_NODES_LIMIT,
         legacy_nodes_limit=True,
     )
+    # Run the nodes query before responding, so that limit errors are not streamed
+    nodes = await anext(chunks, None)
 
-    await UserQuery.resolve_elements_users(elements)
-
-    xattr = get_xattr()
     minx, miny, maxx, maxy = geometry.bounds
-    return {
-        'bounds': {
-            xattr('minlon'): minx,
-            xattr('minlat'): miny,
-            xattr('maxlon'): maxx,
-            xattr('maxlat'): maxy,
-        },
-        **Format06.encode_elements(elements),
-    }
+
+    if format_style.is_json():
+        return OSMResponse.stream_json(
+            _encode_chunks(
+                nodes,
+                chunks,
+                lambda elements: Format06.encode_elements(elements)['elements'],
+            ),
+            head={
+                'bounds': {
+                    'minlon': minx,
+                    'minlat': miny,
+                    'maxlon': maxx,
+                    'maxlat': maxy,
+                }
+            },
+        )
+
+    bounds = (
+        f'<bounds minlon="{minx}" minlat="{miny}"'
+        f' maxlon="{maxx}" maxlat="{maxy}"/>'
+    )
+    return OSMResponse.stream_xml(
+        _encode_chunks(nodes, chunks, Format06.encode_elements_xml),
+        head=bounds.encode(),
+    )
+
+
+async def _encode_chunks(
+    nodes: list[Element] | None,
+    chunks: AsyncIterator[list[Element]],
+    encode: Callable[[list[Element]], Any],
+):
+    async with aclosing(chunks):
+        if nodes is None:
+            return
+
+        await UserQuery.resolve_elements_users(nodes)
+        yield encode(nodes)
+        del nodes
+
+        async for elements in chunks:
+            await UserQuery.resolve_elements_users(elements)
+            yield encode(elements)
@@ -1,3 +1,5 @@
+from collections.abc import AsyncIterator
+from contextlib import aclosing
 from typing import Annotated
 
 from fastapi import APIRouter, Query
@@ -6,25 +8,45 @@ from app.config import MAP_QUERY_AREA_MAX_SIZE, MAP_QUERY_LEGACY_NODES_LIMIT
 from app.exceptions.context import raise_for
 from app.format import Format07
 from app.lib.geo.parse import parse_bbox
-from app.queries.element_query import ElementQuery
+from app.models.db.element import Element
+from app.queries.element_map_query import ElementMapQuery
 from app.queries.user_query import UserQuery
+from app.responses.osm import OSMResponse
 
 router = APIRouter(prefix='/api/0.7')
 
 
 # TODO: limits + cursor (1min expiration?)
+# Cursors could resume ElementMapQuery.iter_by_geom at a phase boundary.
 @router.get('/map')
 async def get_map(bbox: Annotated[str, Query()]):
     geometry = parse_bbox(bbox)
     if geometry.area > MAP_QUERY_AREA_MAX_SIZE:
         raise_for.map_query_area_too_big()
 
-    elements = await ElementQuery.find_by_geom(
+    chunks = ElementMapQuery.iter_by_geom(
         geometry,
         nodes_limit=MAP_QUERY_LEGACY_NODES_LIMIT,
         legacy_nodes_limit=True,
     )
+    # Run the nodes query before responding, so that limit errors are not streamed
+    nodes = await anext(chunks, None)
 
-    await UserQuery.resolve_elements_users(elements)
+    return OSMResponse.stream_json(_encode_chunks(nodes, chunks))
 
-    return Format07.encode_elements(elements)
+
+async def _encode_chunks(
+    nodes: list[Element] | None,
+    chunks: AsyncIterator[list[Element]],
+):
+    async with aclosing(chunks):
+        if nodes is None:
+            return
+
+        await UserQuery.resolve_elements_users(nodes)
+        yield Format07.encode_elements(nodes)
+        del nodes
+
+        async for elements in chunks:
+            await UserQuery.resolve_elements_users(elements)
+            yield Format07.encode_elements(elements)
@@ -2,7 +2,6 @@ from asyncio import TaskGroup
 from typing import Annotated
 
 from fastapi import APIRouter
-from polyline_rs import encode_lonlat
 from starlette import status
 from starlette.responses import RedirectResponse
 
@@ -64,9 +63,7 @@ async def _build_data(trace_id: TraceId, *, owner_id: UserId | None = None):
     async with TaskGroup() as tg:
         traces = [trace]
         tg.create_task(UserQuery.resolve_users(traces))
-        tg.create_task(
-            TraceQuery.resolve_coords(traces, limit_per_trace=500, resolution=None)
-        )
+        tg.create_task(TraceQuery.resolve_overview_lines(traces))
 
     return Data(
         id=trace['id'],
@@ -79,5 +76,5 @@ async def _build_data(trace_id: TraceId, *, owner_id: UserId | None = None):
         ),
         size=trace['size'],
         created_at=int(trace['created_at'].timestamp()),
-        line=encode_lonlat(trace['coords'].tolist(), 6),  # type: ignore[reportTypedDictNotRequiredAccess]
+        line=trace['overview_line'],  # type: ignore
     )
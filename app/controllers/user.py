@@ -4,7 +4,6 @@ from datetime import timedelta
 from typing import Annotated
 
 from fastapi import APIRouter, Cookie, Path, Query, Request
-from polyline_rs import encode_lonlat
 from pydantic import SecretStr
 from starlette import status
 from starlette.responses import RedirectResponse
@@ -179,7 +178,7 @@ async def index(display_name: Annotated[DisplayNameNormalizing, Path(min_length=
             user_id=user_id,
             limit=USER_RECENT_ACTIVITY_ENTRIES,
         )
-        await TraceQuery.resolve_coords(traces, limit_per_trace=100, resolution=90)
+        await TraceQuery.resolve_preview_lines(traces)
         return traces
 
     async def diaries_task():
@@ -296,7 +295,7 @@ async def index(display_name: Annotated[DisplayNameNormalizing, Path(min_length=
         summary.tags.extend(trace['tags'])
         summary.visibility = trace['visibility']
         summary.size = trace['size']
-        summary.preview_line = encode_lonlat(trace['coords'].tolist(), 0)  # type: ignore
+        summary.preview_line = trace['preview_line']  # type: ignore
 
     for diary in diaries_t.result():
         summary = profile_page_state.diaries.add()
@@ -1,14 +1,33 @@
 import logging
-from asyncio import Future, TaskGroup, sleep
-from collections.abc import Callable, Coroutine, Mapping, Sequence
+from asyncio import Future, Task, TaskGroup, get_running_loop, sleep, wait
+from collections import deque
+from collections.abc import (
+    Awaitable,
+    Callable,
+    Coroutine,
+    Hashable,
+    Iterable,
+    Mapping,
+    Sequence,
+)
 from contextlib import asynccontextmanager, contextmanager, nullcontext
+from contextvars import ContextVar
 from functools import wraps
 from pathlib import Path
+from random import choice
 from string.templatelib import Template
 from tempfile import TemporaryDirectory
 from time import monotonic
-from typing import Any, Literal, LiteralString, ParamSpec, TypeAlias, TypeVar, overload
-from weakref import WeakSet
+from typing import (
+    Any,
+    Generic,
+    Literal,
+    LiteralString,
+    ParamSpec,
+    TypeAlias,
+    TypeVar,
+    overload,
+)
 
 import cython
 import duckdb
@@ -16,7 +35,7 @@ import orjson
 from psycopg import AsyncConnection, IsolationLevel, OperationalError, postgres
 from psycopg.abc import AdaptContext
 from psycopg.pq import Format
-from psycopg.rows import dict_row
+from psycopg.rows import AsyncRowFactory, dict_row, tuple_row
 from psycopg.sql import SQL, Identifier
 from psycopg.types import TypeInfo
 from psycopg.types.composite import CompositeInfo, register_composite
@@ -30,15 +49,30 @@ from sentry_sdk import capture_exception
 from app.config import (
     DUCKDB_MEMORY_LIMIT,
     DUCKDB_TMPDIR,
+    POSTGRES_POOL_MAX_IDLE,
+    POSTGRES_POOL_MAX_SIZE,
+    POSTGRES_REPLICA_MAX_LAG,
+    POSTGRES_REPLICA_POLL_INTERVAL,
+    POSTGRES_REPLICA_URLS,
     POSTGRES_STATEMENT_TIMEOUT,
     POSTGRES_URL,
 )
+from app.middlewares.replica_lsn_middleware import (
+    get_client_write_lsn,
+    set_client_write_lsn,
+)
 from app.middlewares.request_context_middleware import is_request
 
 _P = ParamSpec('_P')
 _R = TypeVar('_R')
 
 
+# Connections opened for requests start with the statement timeout already set
+_TIMEOUT_OPTIONS = (
+    f'-c statement_timeout={int(POSTGRES_STATEMENT_TIMEOUT.total_seconds() * 1000)}'
+)
+
+
 async def _configure_connection(conn: AsyncConnection):
     cursor = conn.cursor
 
@@ -52,20 +86,178 @@ async def _configure_connection(conn: AsyncConnection):
     conn.cursor = wrapped  # type: ignore
 
 
+async def _apply_session(
+    conn: AsyncConnection,
+    read_only: bool,
+    autocommit: bool,
+    isolation_level: IsolationLevel | None,
+):
+    """Switch a checked out connection to the session settings, applied on BEGIN."""
+    if conn.read_only != read_only:
+        await conn.set_read_only(read_only)
+    if conn.autocommit != autocommit:
+        await conn.set_autocommit(autocommit)
+    if conn.isolation_level != isolation_level:
+        await conn.set_isolation_level(isolation_level)
+
+
 @cython.cfunc
-def _init_pool():
-    global _PSYCOPG_POOL
-    _PSYCOPG_POOL = AsyncConnectionPool(  # pyright: ignore [reportConstantRedefinition]
-        POSTGRES_URL,
-        min_size=2,
-        max_size=100,
-        open=False,
-        configure=_configure_connection,
-        num_workers=3,  # workers for opening new connections
-    )
+def _init_pools():
+    assert not _PSYCOPG_POOLS, 'Pools must be closed before reinitializing'
+
+
+@cython.cfunc
+def _get_pool(url: str, timeout: cython.bint) -> AsyncConnectionPool:
+    key = (url, timeout)
+    pool = _PSYCOPG_POOLS.get(key)
+    if pool is None:
+        pool = _PSYCOPG_POOLS[key] = AsyncConnectionPool(
+            url,
+            kwargs={'options': _TIMEOUT_OPTIONS} if timeout else None,
+            # a process mostly serves either requests or background tasks,
+            # the other pool keeps no idle connections
+            min_size=0,
+            max_size=POSTGRES_POOL_MAX_SIZE,
+            open=False,
+            configure=_configure_connection,
+            num_workers=3,  # workers for opening new connections
+            max_idle=POSTGRES_POOL_MAX_IDLE.total_seconds(),
+        )
+    return pool
+
+
+async def _close_pools():
+    pools = list(_PSYCOPG_POOLS.values())
+    _PSYCOPG_POOLS.clear()
+    async with TaskGroup() as tg:
+        for pool in pools:
+            tg.create_task(pool.close())
+
+
+# Pools by (server, statement timeout), so that connections never switch timeouts
+_PSYCOPG_POOLS: dict[tuple[str, bool], AsyncConnectionPool] = {}
+
+
+class _Replica:
+    __slots__ = ('replay_lsn', 'url')
+
+    def __init__(self, url: str):
+        self.url = url
+        self.replay_lsn: int = -1  # unavailable until polled
 
 
-_PSYCOPG_POOL: AsyncConnectionPool
+_REPLICAS = tuple(_Replica(url) for url in POSTGRES_REPLICA_URLS.split())
+_LSN_SQL = SQL("SELECT pg_wal_lsn_diff({}, '0/0')::bigint")
+_REPLAY_LSN_SQL = _LSN_SQL.format(SQL('pg_last_wal_replay_lsn()'))
+_CURRENT_LSN_SQL = _LSN_SQL.format(SQL('pg_current_wal_lsn()'))
+
+# Primary LSN samples, for measuring how far behind the replicas are
+_PRIMARY_LSN_SAMPLES: deque[tuple[float, int]] = deque()
+
+# Primary LSN as of POSTGRES_REPLICA_MAX_LAG ago, which replicas must have replayed
+_REPLICA_MIN_LSN: int = 0
+
+# Primary LSN after each user's latest write, for read-your-writes on replicas.
+# The client also carries it in a cookie, this covers API clients in the process.
+# Entries are dropped once no replica that may serve reads is behind them.
+_USER_WRITE_LSN: dict[int, int] = {}
+_USER_WRITE_LSN_MAX_SIZE = 100_000
+
+
+async def _poll_replicas():
+    """Keep track of the replay LSN of each replica, and of the primary LSN."""
+    global _REPLICA_MIN_LSN
+    max_lag = POSTGRES_REPLICA_MAX_LAG.total_seconds()
+
+    while True:
+        try:
+            pool = _get_pool(POSTGRES_URL, False)
+            if pool.closed:
+                await pool.open()
+            async with pool.connection(POSTGRES_REPLICA_POLL_INTERVAL) as conn:
+                await _apply_session(conn, True, False, None)
+                async with await conn.execute(_CURRENT_LSN_SQL) as r:
+                    current_lsn: int = (await r.fetchone())[0]  # type: ignore
+        except Exception:
+            logging.warning('Failed to poll the primary LSN', exc_info=True)
+        else:
+            now = monotonic()
+            samples = _PRIMARY_LSN_SAMPLES
+            samples.append((now, current_lsn))
+            # Keep the newest sample at least max_lag old, if any
+            while len(samples) > 1 and samples[1][0] <= now - max_lag:
+                samples.popleft()
+            _REPLICA_MIN_LSN = (  # pyright: ignore [reportConstantRedefinition]
+                samples[0][1]
+            )
+
+        for i, replica in enumerate(_REPLICAS):
+            try:
+                pool = _get_pool(replica.url, False)
+                if pool.closed:
+                    await pool.open()
+                async with pool.connection(POSTGRES_REPLICA_POLL_INTERVAL) as conn:
+                    await _apply_session(conn, True, False, None)
+                    async with await conn.execute(_REPLAY_LSN_SQL) as r:
+                        replay_lsn: int | None = (await r.fetchone())[0]  # type: ignore
+                # NULL when the server is not in recovery
+                replica.replay_lsn = replay_lsn if replay_lsn is not None else -1
+            except Exception:
+                if replica.replay_lsn >= 0:
+                    logging.warning('Replica %d is unavailable', i, exc_info=True)
+                replica.replay_lsn = -1
+
+        # Replicas behind _REPLICA_MIN_LSN are not read from
+        min_replay_lsn = max(
+            min(replica.replay_lsn for replica in _REPLICAS), _REPLICA_MIN_LSN
+        )
+        for user_id, lsn in tuple(_USER_WRITE_LSN.items()):
+            if lsn <= min_replay_lsn:
+                del _USER_WRITE_LSN[user_id]
+
+        await sleep(POSTGRES_REPLICA_POLL_INTERVAL)
+
+
+@cython.cfunc
+def _user_id():
+    # Lazy import to avoid circular imports
+    from app.lib.auth.context import auth_user  # noqa: PLC0415
+
+    user = auth_user()
+    return user['id'] if user is not None else None
+
+
+@cython.cfunc
+def _route_replica(min_lsn: int | None):
+    """Pick a replica that replayed at least min_lsn, or None for the primary."""
+    if min_lsn is None:
+        min_lsn = get_client_write_lsn()
+        user_id = _user_id()
+        if user_id is not None:
+            min_lsn = max(min_lsn, _USER_WRITE_LSN.get(user_id, 0))
+
+    # Bound the staleness of all reads, including anonymous ones
+    min_lsn = max(min_lsn, _REPLICA_MIN_LSN)
+    candidates = [r.url for r in _REPLICAS if r.replay_lsn >= min_lsn]
+    return choice(candidates) if candidates else None
+
+
+async def _track_write_lsn(conn: AsyncConnection):
+    """Remember the primary LSN after the client's write is committed."""
+    if not conn.autocommit:
+        await conn.commit()
+    async with await conn.execute(_CURRENT_LSN_SQL) as r:
+        lsn: int = (await r.fetchone())[0]  # type: ignore
+
+    set_client_write_lsn(lsn)
+    user_id = _user_id()
+    if user_id is None:
+        return
+
+    _USER_WRITE_LSN.pop(user_id, None)
+    _USER_WRITE_LSN[user_id] = lsn
+    if len(_USER_WRITE_LSN) > _USER_WRITE_LSN_MAX_SIZE:
+        del _USER_WRITE_LSN[next(iter(_USER_WRITE_LSN))]
 
 
 set_json_dumps(orjson.dumps)
@@ -77,18 +269,28 @@ set_json_loads(orjson.loads)
 
 @asynccontextmanager
 async def psycopg_pool_open():
-    """Open and close the psycopg pool."""
+    """Open and close the psycopg pools."""
     from app.services.migration_service import MigrationService  # noqa: PLC0415
 
-    _init_pool()
-    async with _PSYCOPG_POOL:
+    _init_pools()
+    try:
         await MigrationService.migrate_database()
         await _register_types()
-        # Reset the connection pool to ensure the new types are used.
+    finally:
+        # Reset the connection pools to ensure the new types are used.
+        await _close_pools()
 
-    _init_pool()
-    async with _PSYCOPG_POOL:
-        yield
+    _init_pools()
+    try:
+        if _REPLICAS:
+            async with TaskGroup() as tg:
+                task = tg.create_task(_poll_replicas())
+                yield
+                task.cancel()
+        else:
+            yield
+    finally:
+        await _close_pools()
 
 
 def psycopg_pool_open_decorator(func: Callable[_P, Coroutine[Any, Any, _R]]):
@@ -164,12 +366,14 @@ async def db(
     *,
     autocommit: bool = False,
     isolation_level: IsolationLevel | None = None,
-    _TIMEOUT_CONNS=WeakSet[AsyncConnection](),
-    _TIMEOUT_SQL=SQL('SET statement_timeout = {}').format(
-        int(POSTGRES_STATEMENT_TIMEOUT.total_seconds() * 1000)
-    ),
+    replica: bool = False,
+    min_lsn: int | None = None,
 ):
-    """Get a database connection."""
+    """
+    Get a database connection.
+    Read-only sessions with replica=True may be served by a read replica that has
+    replayed at least min_lsn, defaulting to the current user's latest write.
+    """
     if not isinstance(write, bool):
         assert conn is None
         conn = write
@@ -185,30 +389,21 @@ async def db(
         yield conn
         return
 
-    async with _PSYCOPG_POOL.connection() as conn:
-        is_request_: cython.bint = is_request()
-        has_timeout: cython.bint = conn in _TIMEOUT_CONNS
-        if (is_request_ and not has_timeout) or (not is_request_ and has_timeout):
-            if conn.read_only:
-                await conn.set_read_only(False)
-            if not conn.autocommit:
-                await conn.set_autocommit(True)
-
-            if is_request_:
-                await conn.execute(_TIMEOUT_SQL)
-                _TIMEOUT_CONNS.add(conn)
-            else:
-                await conn.execute('RESET statement_timeout')
-                _TIMEOUT_CONNS.discard(conn)
+    assert not replica or read_only, 'replica=True must be used with write=False'
 
-        if conn.read_only != read_only:
-            await conn.set_read_only(read_only)
-        if conn.autocommit != autocommit:
-            await conn.set_autocommit(autocommit)
-        if conn.isolation_level != isolation_level:
-            await conn.set_isolation_level(isolation_level)
+    url = (replica and _REPLICAS and _route_replica(min_lsn)) or POSTGRES_URL
+    request: cython.bint = is_request()
+    pool = _get_pool(url, request)
+    if pool.closed:
+        await pool.open()
 
+    track_write: cython.bint = write and request and bool(_REPLICAS)
+
+    async with pool.connection() as conn:
+        await _apply_session(conn, read_only, autocommit, isolation_level)
         yield conn
+        if track_write:
+            await _track_write_lsn(conn)
 
 
 @asynccontextmanager
@@ -403,6 +598,8 @@ def duckdb_connect(database: str | Path = ':memory:', *, progress: bool = True):
 
 
 _T = TypeVar('_T')
+_K = TypeVar('_K', bound=Hashable)
+_V = TypeVar('_V')
 
 # Plain values parameter-bind; Template values embed raw SQL expressions
 # (e.g., t'statement_timestamp()', t'ST_QuantizeCoordinates({p}, 7)', t'DEFAULT').
@@ -415,6 +612,195 @@ def _db_or(conn: AsyncConnection | None, write: cython.bint = False):
     return nullcontext(conn) if conn is not None else db(write)
 
 
+class _QueryBatch:
+    """
+    Read queries issued during one event loop tick, sent together over one
+    connection in pipeline mode. Results are fetched in submission order.
+    """
+
+    __slots__ = ('_pending',)
+
+    def __init__(self):
+        self._pending: list[tuple[Template, AsyncRowFactory, Future[list]]] = []
+
+    def fetch(
+        self,
+        query: Template,
+        row_factory: AsyncRowFactory,
+        limit: int | None = None,
+        offset: int | None = None,
+    ) -> Future[list]:
+        # Batched queries always run on a read-only connection, so FOR UPDATE is skipped
+        query = _apply_trailing(query, limit, offset, False, None)
+        loop = get_running_loop()
+        future: Future[list] = loop.create_future()
+        if not self._pending:
+            # The flush task runs after the tasks that are already scheduled
+            task = loop.create_task(self._flush())
+            _BATCH_TASKS.add(task)
+            task.add_done_callback(_BATCH_TASKS.discard)
+        self._pending.append((query, row_factory, future))
+        return future
+
+    async def _flush(self):
+        pending = self._pending
+        self._pending = []
+        try:
+            if len(pending) > 1:
+                try:
+                    await _fetch_pipelined(pending)
+                except Exception:
+                    # A failed query aborts the rest of the pipeline. Retry the
+                    # unresolved queries one by one, so that only the failing
+                    # query's future gets the error.
+                    logging.debug('Retrying batched queries after pipeline error')
+                pending = [item for item in pending if not item[2].done()]
+            if pending:
+                await _fetch_each(pending)
+        except Exception as e:
+            for _, _, future in pending:
+                if not future.done():
+                    future.set_exception(e)
+        finally:
+            for _, _, future in pending:
+                future.cancel()
+
+
+async def _fetch_pipelined(
+    pending: list[tuple[Template, AsyncRowFactory, Future[list]]],
+):
+    async with db() as conn, conn.pipeline():
+        cursors = [conn.cursor(row_factory=row_factory) for _, row_factory, _ in pending]
+        for cursor, (query, _, _) in zip(cursors, pending, strict=True):
+            await cursor.execute(query)
+        for cursor, (_, _, future) in zip(cursors, pending, strict=True):
+            rows = await cursor.fetchall()
+            if not future.done():
+                future.set_result(rows)
+
+
+async def _fetch_each(pending: list[tuple[Template, AsyncRowFactory, Future[list]]]):
+    async with db() as conn:
+        for query, row_factory, future in pending:
+            try:
+                # Savepoint, so that a failed query doesn't abort the following ones
+                async with conn.transaction():
+                    cursor = conn.cursor(row_factory=row_factory)
+                    async with await cursor.execute(query) as r:
+                        rows = await r.fetchall()
+            except Exception as e:
+                if not future.done():
+                    future.set_exception(e)
+            else:
+                if not future.done():
+                    future.set_result(rows)
+
+
+_BATCH_CTX = ContextVar[_QueryBatch | None]('DBBatch', default=None)
+_LOADER_CTX = ContextVar[dict['DBLoader', '_LoaderState'] | None](
+    'DBLoader', default=None
+)
+_BATCH_TASKS: set[Task[None]] = set()
+
+
+@contextmanager
+def db_batch():
+    """
+    Batch the db_fetch* calls made without conn in this context.
+    Independent queries issued concurrently (e.g., resolve_* helpers in a TaskGroup)
+    share a single round trip instead of checking out a connection each.
+    DBLoader lookups are memoized for the lifetime of the context.
+    """
+    with _BATCH_CTX.set(_QueryBatch()), _LOADER_CTX.set({}):
+        yield
+
+
+_MISSING: Any = object()
+
+
+class _LoaderState:
+    __slots__ = ('_cache', '_load', '_pending')
+
+    def __init__(self, load: Callable[[list], Awaitable[Iterable[tuple]]]):
+        self._load = load
+        self._cache: dict[Any, Future] = {}
+        self._pending: list = []
+
+    async def load_many(self, keys: Iterable) -> dict:
+        loop = get_running_loop()
+        futures: dict[Any, Future] = {}
+        for key in keys:
+            future = self._cache.get(key)
+            if future is None:
+                future = self._cache[key] = loop.create_future()
+                if not self._pending:
+                    task = loop.create_task(self._flush())
+                    _BATCH_TASKS.add(task)
+                    task.add_done_callback(_BATCH_TASKS.discard)
+                self._pending.append(key)
+            futures[key] = future
+
+        if not futures:
+            return {}
+
+        # Futures are shared between callers, so they must not be cancelled by waiting
+        await wait(futures.values())
+        result = {}
+        for key, future in futures.items():
+            value = future.result()
+            if value is not _MISSING:
+                result[key] = value
+        return result
+
+    async def _flush(self):
+        keys = self._pending
+        self._pending = []
+        try:
+            values = dict(await self._load(keys))
+        except BaseException as e:
+            # Failed lookups are not memoized
+            for key in keys:
+                future = self._cache.pop(key)
+                if isinstance(e, Exception):
+                    future.set_exception(e)
+                else:
+                    future.cancel()
+            if not isinstance(e, Exception):
+                raise
+            return
+
+        for key in keys:
+            self._cache[key].set_result(values.get(key, _MISSING))
+
+
+class DBLoader(Generic[_K, _V]):
+    """
+    Batched key lookup, memoized within db_batch().
+    Keys requested during one event loop tick are coalesced into a single load call.
+    The load function returns (key, value) pairs; keys without a pair are omitted.
+    """
+
+    __slots__ = ('_load',)
+
+    def __init__(self, load: Callable[[list[_K]], Awaitable[Iterable[tuple[_K, _V]]]]):
+        self._load = load
+
+    async def load_many(self, keys: Iterable[_K]) -> dict[_K, _V]:
+        states = _LOADER_CTX.get()
+        if states is None:
+            return dict(await self._load(list(keys)))
+
+        state = states.get(self)
+        if state is None:
+            state = states[self] = _LoaderState(self._load)
+        return await state.load_many(keys)
+
+
+@cython.cfunc
+def _batch_or_none(conn: AsyncConnection | None) -> _QueryBatch | None:
+    return _BATCH_CTX.get() if conn is None else None
+
+
 @cython.cfunc
 def _value_tpl(v) -> Template:
     """Plain value → parameter-bound; Template → raw embed."""
@@ -458,7 +844,7 @@ def _apply_trailing(
     limit: int | None,
     offset: int | None,
     for_update: cython.bint,
-    conn: AsyncConnection,
+    conn: AsyncConnection | None,
 ) -> Template:
     """Append LIMIT, OFFSET, and FOR UPDATE in standard SQL clause order.
 
@@ -474,7 +860,7 @@ def _apply_trailing(
         query = t'{query:q} LIMIT {limit}'
     if offset is not None:
         query = t'{query:q} OFFSET {offset}'
-    if for_update and not conn.read_only:
+    if for_update and conn is not None and not conn.read_only:
         query = t'{query:q} FOR UPDATE'
     return query
 
@@ -546,6 +932,10 @@ async def db_fetchone(
     - `for_update=True` appends `FOR UPDATE` to lock the matched row; silently
       skipped if the connection is read-only.
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        rows = await batch.fetch(query, dict_row)
+        return rows[0] if rows else None
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, None, None, for_update, conn)
         async with await conn.cursor(row_factory=dict_row).execute(query) as r:
@@ -570,6 +960,9 @@ async def db_fetchall(
     - `for_update=True` appends `FOR UPDATE`; silently skipped on read-only conn.
       Combined with `limit`, only the returned rows are locked (LIMIT applies first).
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        return await batch.fetch(query, dict_row, limit, offset)
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, limit, offset, for_update, conn)
         async with await conn.cursor(row_factory=dict_row).execute(query) as r:
@@ -587,6 +980,10 @@ async def db_fetchrow(
 
     - `for_update=True` appends `FOR UPDATE`; silently skipped on read-only conn.
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        rows = await batch.fetch(query, tuple_row)
+        return rows[0] if rows else None
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, None, None, for_update, conn)
         async with await conn.execute(query) as r:
@@ -611,6 +1008,9 @@ async def db_fetchrows(
       `for_update=True` appends `FOR UPDATE` (silently skipped on read-only conn).
       Combined with `limit`, only the returned rows are locked (LIMIT applies first).
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        return await batch.fetch(query, tuple_row, limit, offset)
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, limit, offset, for_update, conn)
         async with await conn.execute(query) as r:
@@ -638,6 +1038,9 @@ async def db_fetchcol(
       `for_update=True` appends `FOR UPDATE`. Combined with `limit`, only the
       returned rows are locked (LIMIT applies first).
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        return [c for (c,) in await batch.fetch(query, tuple_row, limit, offset)]
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, limit, offset, for_update, conn)
         async with await conn.execute(query) as r:
@@ -661,6 +1064,10 @@ async def db_fetchval(
 
     - `for_update=True` appends `FOR UPDATE`; silently skipped on read-only conn.
     """
+    if (batch := _batch_or_none(conn)) is not None:
+        rows = await batch.fetch(query, tuple_row)
+        return rows[0][0] if rows else None
+
     async with _db_or(conn) as conn:
         query = _apply_trailing(query, None, None, for_update, conn)
         async with await conn.execute(query) as r:
@@ -1,9 +1,12 @@
 import logging
+from collections.abc import AsyncIterable
 
 import cython
 import numpy as np
+from pydantic import ByteSize
 from shapely import Point, get_coordinates, points
 
+from app.config import LEGACY_HIGH_PRECISION_TIME, XML_PARSE_MAX_SIZE
 from app.exceptions.context import raise_for
 from app.lib.render import format_style
 from app.lib.time.date_utils import legacy_date
@@ -13,6 +16,8 @@ from app.models.proto.shared_types import ElementType
 from app.models.types import ChangesetId
 from app.services.optimistic_diff.prepare import OSMChangeAction
 from speedup import (
+    ElementXMLWriter,
+    OSMChangeDecoder,
     element_id,
     element_type,
     split_typed_element_id,
@@ -58,6 +63,40 @@ class Element06Mixin:
             result[type].append(_encode_element(element, is_json=False))
         return result
 
+    @staticmethod
+    def encode_elements_xml(
+        elements: list[Element],
+        *,
+        osmchange: bool = False,
+        head: bytes = b'',
+        tail: bytes = b'',
+    ) -> bytes:
+        """
+        Encode elements directly to XML bytes, skipping the intermediate dicts.
+        Elements are grouped by type, or wrapped in osmChange actions.
+        The head and tail bytes are written around the encoded elements.
+        """
+        element_points = [
+            point  #
+            for element in elements
+            if (point := element['point']) is not None
+        ]
+        coords = (
+            get_coordinates(element_points).round(7).tobytes()  #
+            if element_points
+            else b''
+        )
+
+        # A writer per call: safe across threads, and large buffers are freed with it
+        writer = ElementXMLWriter(LEGACY_HIGH_PRECISION_TIME)
+        writer.write(head)
+        if osmchange:
+            writer.write_osmchange(elements, coords)
+        else:
+            writer.write_elements(elements, coords)
+        writer.write(tail)
+        return writer.take()
+
     @staticmethod
     def decode_elements(elements: list[tuple[ElementType, dict]]):
         """
@@ -183,6 +222,75 @@ class Element06Mixin:
 
         return result
 
+    @staticmethod
+    def decode_osmchange_xml(changeset_id: ChangesetId | None, xml: bytes):
+        """
+        Decode osmChange XML directly into elements, skipping the generic dict tree.
+        Equivalent to decode_osmchange(changeset_id, XMLToDict.parse(xml)['osmChange']).
+        If changeset_id is None, it will be extracted from the element data.
+
+        >>> decode_osmchange_xml(None, b'<osmChange><create><node id="-1" .../></create></osmChange>')
+        [ElementInit(typed_id=..., version=1, ...)]
+        """
+        decoder = OSMChangeDecoder(changeset_id)
+        result = _decode_points(*decoder.feed(xml))
+        result.extend(_decode_points(*decoder.close()))
+        return result
+
+    @staticmethod
+    async def decode_osmchange_aiter(
+        changeset_id: ChangesetId | None,
+        chunks: AsyncIterable[bytes],
+        *,
+        size_limit: int | ByteSize | None = XML_PARSE_MAX_SIZE,
+    ):
+        """
+        Decode osmChange XML chunks as they arrive, see decode_osmchange_xml.
+        Only the decoded elements are kept in memory, not the document.
+        """
+        decoder = OSMChangeDecoder(changeset_id)
+        result: list[ElementInit] = []
+        chunk = b''
+        offset: int = 0
+
+        try:
+            async for chunk in chunks:
+                if size_limit is not None and offset + len(chunk) > size_limit:
+                    raise_for.input_too_big(offset + len(chunk))
+                result.extend(_decode_points(*decoder.feed(chunk)))
+                offset += len(chunk)
+            chunk = b''
+            result.extend(_decode_points(*decoder.close()))
+        # Element type and id errors surface as NotImplementedError and OverflowError
+        except (ValueError, OverflowError, NotImplementedError) as e:
+            raise_for.bad_xml(
+                'osmChange',
+                f'{e} (in chunk at byte offset {offset})',
+                # Chunk boundaries may split multi-byte characters
+                chunk.decode(errors='replace').encode(),
+            )
+
+        return result
+
+
+@cython.cfunc
+def _decode_points(
+    elements: list[ElementInit], point_indices: bytes, point_coords: bytes
+):
+    """Set the points of the decoded elements, materialized in bulk."""
+    if not point_indices:
+        return elements
+
+    indices = np.frombuffer(point_indices, np.uint64).tolist()
+    coords = np.frombuffer(point_coords, np.float64).reshape(-1, 2).round(7)
+
+    i: int
+    point: Point
+    for i, point in zip(indices, points(coords).tolist()):  # type: ignore
+        elements[i]['point'] = point
+
+    return elements
+
 
 @cython.cfunc
 def _encode_nodes_json(nodes: list[TypedElementId]):
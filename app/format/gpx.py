@@ -1,12 +1,17 @@
-from datetime import datetime
+from datetime import UTC, datetime, timedelta
 from typing import Any, NamedTuple
 
 import cython
-from shapely import MultiLineString, get_coordinates
+import numpy as np
+from shapely import MultiLineString, get_coordinates, linestrings, multilinestrings
 
 from app.exceptions.context import raise_for
 from app.models.db.trace import Trace, trace_is_timestamps_via_api
 
+# Capture time marker of points without a <time> element, see speedup.gpx_decode
+_NO_TIME = np.iinfo(np.int64).min
+_EPOCH = datetime(1970, 1, 1, tzinfo=UTC)
+
 
 class DecodeTracksResult(NamedTuple):
     size: int
@@ -77,57 +82,47 @@ class FormatGPX:
         return {'trk': trk}
 
     @staticmethod
-    def decode_tracks(tracks: list[dict]):
-        size: cython.size_t = 0
-        segments: list[list[tuple[float, float]]] = []
-        elevations: list[float | None] = []
-        capture_times: list[datetime | None] = []
-        has_elevation: cython.bint = False
-        has_capture_times: cython.bint = False
-
-        for track in tracks:
-            for segment in track.get('trkseg', ()):
-                points: list[tuple[float, float]] = []  # (lon, lat)
-
-                for point in segment.get('trkpt', ()):
-                    if (
-                        (lon := point.get('@lon')) is None  #
-                        or (lat := point.get('@lat')) is None
-                    ):
-                        continue
-
-                    # Get elevation if available
-                    elevation: float | None = point.get('ele')
-                    if elevation is not None:
-                        has_elevation = True
-
-                    # Get timestamp if available
-                    time: datetime | None = point.get('time')
-                    if time is not None:
-                        has_capture_times = True
-
-                    # Add the point with elevation
-                    points.append((lon, lat))
-                    elevations.append(elevation)
-                    capture_times.append(time)
-
-                # Finish the segment if non-empty
-                segment_size: cython.size_t = len(points)
-                if segment_size:
-                    if segment_size < 2:
-                        raise_for.bad_trace_file(
-                            'Trace segment is too short or incomplete'
-                        )
-
-                    size += segment_size
-                    segments.append(points)
+    def decode_tracks(gpx_files: list[tuple[bytes, bytes, bytes, bytes]]):
+        """
+        Build a trace from decoded GPX files (see speedup.gpx_decode).
+        Geometry is built directly from the columnar arrays, without per-point objects.
+        """
+        if not gpx_files:
+            raise_for.bad_trace_file('Trace is too short or incomplete')
+
+        segment_sizes = np.concatenate([
+            np.frombuffer(f[1], np.uint64) for f in gpx_files
+        ])
+        if (segment_sizes < 2).any():
+            raise_for.bad_trace_file('Trace segment is too short or incomplete')
 
+        size: cython.size_t = int(segment_sizes.sum())
         if size < 2:
             raise_for.bad_trace_file('Trace is too short or incomplete')
 
-        return DecodeTracksResult(
-            size,
-            MultiLineString(segments),
-            elevations if has_elevation else None,
-            capture_times if has_capture_times else None,
-        )
+        coords = np.concatenate([
+            np.frombuffer(f[0], np.float64) for f in gpx_files
+        ]).reshape(-1, 2)
+        segment_index = np.repeat(np.arange(len(segment_sizes)), segment_sizes)
+        segments = multilinestrings(linestrings(coords, indices=segment_index))
+
+        elevations_arr = np.concatenate([
+            np.frombuffer(f[2], np.float32) for f in gpx_files
+        ])
+        elevations_missing = np.isnan(elevations_arr)
+        elevations: list[float | None] | None = None
+        if not elevations_missing.all():
+            elevations_obj = elevations_arr.astype(np.float64).astype(np.object_)
+            elevations_obj[elevations_missing] = None
+            elevations = elevations_obj.tolist()
+
+        times_arr = np.concatenate([np.frombuffer(f[3], np.int64) for f in gpx_files])
+        times_missing = times_arr == _NO_TIME
+        capture_times: list[datetime | None] | None = None
+        if not times_missing.all():
+            capture_times = [
+                None if t == _NO_TIME else _EPOCH + timedelta(microseconds=t)
+                for t in times_arr.tolist()
+            ]
+
+        return DecodeTracksResult(size, segments, elevations, capture_times)
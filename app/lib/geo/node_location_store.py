@@ -0,0 +1,251 @@
+import asyncio
+import fcntl
+import logging
+import mmap
+import os
+import struct
+from asyncio import TaskGroup, to_thread
+from collections.abc import Sequence
+from contextlib import asynccontextmanager
+from pathlib import Path
+
+import cython
+import numpy as np
+from numpy.typing import NDArray
+from shapely import get_coordinates
+
+from app.config import (
+    NODE_LOCATION_STORE_PATH,
+    NODE_LOCATION_STORE_SYNC_BATCH,
+    NODE_LOCATION_STORE_SYNC_INTERVAL,
+)
+from app.db import db_fetchrows, db_fetchval
+from app.lib.http.retry import retry
+from app.models.element import TypedElementId
+from app.models.types import SequenceId
+
+# File layout: magic, uint64 synced sequence_id, then (lon, lat) uint32 pairs
+# indexed by node id. Coordinates are stored as 1e-7 fixed-point, biased by 2^31
+# so that zero-filled (sparse) regions of the file read as missing locations.
+_MAGIC = b'NODELOC1'
+_HEADER_SIZE = 16
+_SCALE = 10_000_000
+_BIAS = 1 << 31
+_GROW_STEP = 1 << 24  # nodes
+
+
+class NodeLocationStore:
+    @staticmethod
+    def enabled() -> bool:
+        """Check if the node location store is configured."""
+        return NODE_LOCATION_STORE_PATH is not None
+
+    @staticmethod
+    @asynccontextmanager
+    async def context():
+        """Context manager for keeping the node location store up to date."""
+        if NODE_LOCATION_STORE_PATH is None:
+            yield
+            return
+
+        await _open(NODE_LOCATION_STORE_PATH)
+        async with TaskGroup() as tg:
+            task = tg.create_task(_sync_task())
+            yield
+            task.cancel()
+        _close()
+
+    @staticmethod
+    def get_coordinates(typed_ids: Sequence[TypedElementId]) -> NDArray[np.float64]:
+        """
+        Get the latest (lon, lat) of the given nodes.
+        Missing or deleted nodes are returned as NaN.
+        """
+        result = np.full((len(typed_ids), 2), np.nan, np.float64)
+        if not typed_ids or _STORE.data is None:
+            return result
+
+        _remap_if_grown()
+        data = _STORE.data
+        ids = np.asarray(typed_ids, np.int64)
+        indices = np.flatnonzero((ids > 0) & (ids < data.shape[0]))
+        values = data[ids[indices]]
+        present = values.any(axis=1)
+        result[indices[present]] = (
+            values[present].astype(np.int64) - _BIAS
+        ) / _SCALE
+        return result
+
+    @staticmethod
+    def sequence_id() -> SequenceId:
+        """Get the sequence_id the store is synced to."""
+        if _STORE.mm is None:
+            return SequenceId(0)
+        return SequenceId(struct.unpack_from('<Q', _STORE.mm, 8)[0])
+
+
+class _Store:
+    __slots__ = ('data', 'fd', 'mm')
+
+    def __init__(self):
+        self.fd: int = -1
+        self.mm: mmap.mmap | None = None
+        self.data: NDArray[np.uint32] | None = None
+
+
+_STORE = _Store()
+
+
+async def _open(path: Path):
+    path.parent.mkdir(parents=True, exist_ok=True)
+    fd = os.open(path, os.O_RDWR | os.O_CREAT, 0o644)
+    # Only a new file needs the lock, the syncing process may hold it for long
+    if os.fstat(fd).st_size < _HEADER_SIZE:
+        async with _locked(fd):
+            if os.fstat(fd).st_size < _HEADER_SIZE:
+                os.ftruncate(fd, _HEADER_SIZE + _GROW_STEP * 8)
+                os.pwrite(fd, _MAGIC + struct.pack('<Q', 0), 0)
+    if os.pread(fd, len(_MAGIC), 0) != _MAGIC:
+        os.close(fd)
+        raise ValueError(f'Invalid node location store file {path}')
+
+    _STORE.fd = fd
+    _map()
+    logging.info(
+        'Opened node location store %s (sequence_id=%d)',
+        path,
+        NodeLocationStore.sequence_id(),
+    )
+
+
+def _close():
+    _STORE.data = None
+    if _STORE.mm is not None:
+        _STORE.mm.close()
+        _STORE.mm = None
+    if _STORE.fd >= 0:
+        os.close(_STORE.fd)
+        _STORE.fd = -1
+
+
+def _map():
+    _STORE.data = None
+    if _STORE.mm is not None:
+        _STORE.mm.close()
+
+    mm = mmap.mmap(_STORE.fd, os.fstat(_STORE.fd).st_size)
+    _STORE.mm = mm
+    _STORE.data = np.frombuffer(mm, np.uint32, offset=_HEADER_SIZE).reshape(-1, 2)
+
+
+@cython.cfunc
+def _remap_if_grown():
+    # Other processes may have grown the file
+    mm = _STORE.mm
+    if mm is not None and os.fstat(_STORE.fd).st_size > len(mm):
+        _map()
+
+
+@asynccontextmanager
+async def _locked(fd: int):
+    """Lock the store file for writing, across processes."""
+    # Only hop to a thread when the lock is contended
+    try:
+        fcntl.flock(fd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+    except BlockingIOError:
+        await to_thread(fcntl.flock, fd, fcntl.LOCK_EX)
+    try:
+        yield
+    finally:
+        fcntl.flock(fd, fcntl.LOCK_UN)
+
+
+def _try_lock(fd: int) -> bool:
+    """Try to lock the store file for writing, without waiting."""
+    try:
+        fcntl.flock(fd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+    except BlockingIOError:
+        return False
+    return True
+
+
+@retry(None)
+async def _sync_task():
+    while True:
+        await _sync()
+        await asyncio.sleep(NODE_LOCATION_STORE_SYNC_INTERVAL)
+
+
+async def _sync():
+    """
+    Apply node changes since the stored sequence_id.
+    Only the process holding the lock syncs, others read the shared file.
+    """
+    if not _try_lock(_STORE.fd):
+        return
+    try:
+        await _sync_locked()
+    finally:
+        fcntl.flock(_STORE.fd, fcntl.LOCK_UN)
+
+
+async def _sync_locked():
+    max_sequence = await db_fetchval(
+        SequenceId, t'SELECT COALESCE(MAX(sequence_id), 0) FROM element'
+    )
+    assert max_sequence is not None
+
+    while (last_sequence := NodeLocationStore.sequence_id()) < max_sequence:
+        end_sequence = min(last_sequence + NODE_LOCATION_STORE_SYNC_BATCH, max_sequence)
+        rows = await db_fetchrows(t"""
+            SELECT typed_id, point FROM element
+            WHERE sequence_id > {last_sequence}
+            AND sequence_id <= {end_sequence}
+            AND typed_id <= 1152921504606846975
+            ORDER BY sequence_id
+        """)
+
+        _apply(rows)
+        struct.pack_into('<Q', _STORE.mm, 8, end_sequence)  # type: ignore
+
+        if last_sequence == 0 or len(rows) >= 100_000:
+            logging.debug(
+                'Synced node location store to sequence_id=%d (%d nodes)',
+                end_sequence,
+                len(rows),
+            )
+
+
+def _apply(rows: list[tuple[TypedElementId, object]]):
+    if not rows:
+        return
+
+    ids = np.fromiter((row[0] for row in rows), np.int64, len(rows))
+    # Keep only the last change of each node, the rows are ordered by sequence_id
+    _, last_rev = np.unique(ids[::-1], return_index=True)
+    last = len(ids) - 1 - last_rev
+    ids = ids[last]
+
+    values = np.zeros((len(ids), 2), np.uint32)
+    points = [rows[i][1] for i in last.tolist()]
+    visible = np.fromiter((p is not None for p in points), np.bool_, len(points))
+    if visible.any():
+        coords = get_coordinates([p for p in points if p is not None])
+        values[visible] = np.rint(coords * _SCALE).astype(np.int64) + _BIAS
+
+    _ensure_capacity(int(ids.max()) + 1)
+    _STORE.data[ids] = values  # type: ignore
+
+
+@cython.cfunc
+def _ensure_capacity(num_nodes: int):
+    _remap_if_grown()
+    data = _STORE.data
+    assert data is not None
+    if num_nodes <= data.shape[0]:
+        return
+    del data  # release the buffer before remapping
+
+    capacity = -(-num_nodes // _GROW_STEP) * _GROW_STEP
+    os.ftruncate(_STORE.fd, _HEADER_SIZE + capacity * 8)
+    _map()
@@ -0,0 +1,44 @@
+import cython
+import numpy as np
+from numpy.typing import NDArray
+from polyline_rs import encode_lonlat
+from shapely import MultiLineString, get_coordinates
+
+from app.lib.geo.mercator import mercator
+
+# Listing thumbnails: up to 100 points projected onto a 90x90 pixel grid
+_PREVIEW_LIMIT = 100
+_PREVIEW_RESOLUTION = 90
+
+# Trace page map: up to 500 points at full precision
+_OVERVIEW_LIMIT = 500
+
+
+def trace_preview_lines(segments: MultiLineString) -> tuple[str, str]:
+    """Encode the preview and overview polylines of the trace segments."""
+    coords = get_coordinates(segments)
+    return (
+        encode_preview_line(sample_coords(coords, _PREVIEW_LIMIT)),
+        encode_overview_line(sample_coords(coords, _OVERVIEW_LIMIT)),
+    )
+
+
+def sample_coords(coords: NDArray[np.floating], limit: cython.size_t):
+    """Sample every n-th point, such that at most ~limit points remain."""
+    step = max(1, coords.shape[0] // limit)
+    return coords[::step]
+
+
+def encode_preview_line(coords: NDArray[np.floating]) -> str:
+    """Encode sampled coordinates as a listing thumbnail polyline."""
+    projected = (
+        mercator(coords, _PREVIEW_RESOLUTION, _PREVIEW_RESOLUTION).astype(np.uint)
+        if coords.shape[0] >= 2
+        else np.empty((0,), dtype=np.uint)
+    )
+    return encode_lonlat(projected.tolist(), 0)
+
+
+def encode_overview_line(coords: NDArray[np.floating]) -> str:
+    """Encode sampled coordinates as a trace page polyline."""
+    return encode_lonlat(coords.tolist(), 6)
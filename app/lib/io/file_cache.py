@@ -1,11 +1,16 @@
 import fcntl
 import logging
+import os
 from asyncio import timeout, to_thread
 from collections import OrderedDict
 from datetime import timedelta
+from functools import cache
+from hashlib import blake2b
 from io import FileIO
+from mmap import mmap
 from os import stat
 from pathlib import Path
+from struct import Struct
 from time import time
 from typing import NamedTuple
 
@@ -17,6 +22,9 @@ from app.config import (
     FILE_CACHE_LOCK_TIMEOUT,
     FILE_CACHE_MEMORY_MAX_ENTRIES,
     FILE_CACHE_MEMORY_MAX_VALUE_SIZE,
+    FILE_CACHE_SHARED_MEMORY_MAX_VALUE_SIZE,
+    FILE_CACHE_SHARED_MEMORY_PATH,
+    FILE_CACHE_SHARED_MEMORY_SIZE,
     FILE_CACHE_SIZE,
 )
 from app.models.proto.server_pb2 import FileCacheMeta
@@ -37,6 +45,168 @@ class _MemoryEntry(NamedTuple):
 
 _MEMORY_CACHES: dict[Path, OrderedDict[str, _MemoryEntry]] = {}
 
+# Shared memory file header: magic, layout version, slot size, number of slots
+_FILE_HEADER = Struct('<8sIQQ')
+_FILE_MAGIC = b'OSMNGFC\0'
+_FILE_VERSION = 1
+_FILE_DATA_OFFSET = 64
+
+# Shared memory slot header: sequence, key digest, expires_at (0 if none), mtime, size
+_SLOT_SEQ = Struct('<Q')
+_SLOT_HEADER = Struct('<Q16sqdI')
+_SLOT_DATA_OFFSET = 64
+
+
+class _SharedMemory:
+    """
+    Direct-mapped cache slots in a memory-mapped file, shared by all processes on the host.
+    Reads are lock-free and validated with a per-slot sequence number (seqlock).
+    Writes take a non-blocking byte-range lock on the slot and are skipped when contended.
+    The file is never resized in place: a file with another layout is replaced,
+    and processes that still map it keep using it until they exit.
+    """
+
+    __slots__ = ('_fd', '_mmap', '_num_slots', '_slot_size', 'max_value_size')
+
+    def __init__(self, path: Path, size: int, max_value_size: int):
+        self.max_value_size = max_value_size
+        self._slot_size = _SLOT_DATA_OFFSET + max_value_size
+        self._num_slots = size // self._slot_size
+        assert self._num_slots > 0, 'Shared memory must fit at least one slot'
+        size = _FILE_DATA_OFFSET + self._num_slots * self._slot_size
+        header = _FILE_HEADER.pack(
+            _FILE_MAGIC, _FILE_VERSION, self._slot_size, self._num_slots
+        )
+        self._fd = _open_shared_file(path, header, size)
+        self._mmap = mmap(self._fd, size)
+
+    def get(self, digest: bytes) -> _MemoryEntry | None:
+        buf = self._mmap
+        offset = self._slot_offset(digest)
+        header = _SLOT_HEADER.unpack_from(buf, offset)
+        seq, slot_digest, expires_at, mtime, size = header
+        if seq & 1 or slot_digest != digest or size > self.max_value_size:
+            return None
+
+        data_offset = offset + _SLOT_DATA_OFFSET
+        data = buf[data_offset : data_offset + size]
+
+        # Discard the read if a writer touched the slot in the meantime
+        if _SLOT_SEQ.unpack_from(buf, offset)[0] != seq:
+            return None
+
+        return _MemoryEntry(expires_at or None, data, mtime)
+
+    def set(self, digest: bytes, entry: _MemoryEntry | None) -> bool:
+        """
+        Write the entry into its slot, or clear the slot if entry is None.
+        Returns False if the slot was busy and the write was skipped.
+        """
+        offset = self._slot_offset(digest)
+        try:
+            fcntl.lockf(
+                self._fd,
+                fcntl.LOCK_EX | fcntl.LOCK_NB,
+                self._slot_size,
+                offset,
+                os.SEEK_SET,
+            )
+        except OSError:
+            logging.debug('Shared memory slot is busy, skipping write')
+            return False
+
+        try:
+            buf = self._mmap
+            seq: int = _SLOT_SEQ.unpack_from(buf, offset)[0]
+            if entry is None and buf[offset + 8 : offset + 24] != digest:
+                return True
+
+            seq |= 1  # odd while writing, also recovers from interrupted writes
+            _SLOT_SEQ.pack_into(buf, offset, seq)
+            if entry is not None:
+                data = entry.data
+                _SLOT_HEADER.pack_into(
+                    buf,
+                    offset,
+                    seq,
+                    digest,
+                    entry.expires_at or 0,
+                    entry.mtime,
+                    len(data),
+                )
+                data_offset = offset + _SLOT_DATA_OFFSET
+                buf[data_offset : data_offset + len(data)] = data
+            else:
+                _SLOT_HEADER.pack_into(buf, offset, seq, bytes(16), 0, 0, 0)
+            _SLOT_SEQ.pack_into(buf, offset, seq + 1)
+            return True
+        finally:
+            fcntl.lockf(self._fd, fcntl.LOCK_UN, self._slot_size, offset, os.SEEK_SET)
+
+    def _slot_offset(self, digest: bytes, /) -> int:
+        index = int.from_bytes(digest[:8], 'little') % self._num_slots
+        return _FILE_DATA_OFFSET + index * self._slot_size
+
+
+def _open_shared_file(path: Path, header: bytes, size: int) -> int:
+    """
+    Open the shared memory file, creating it if missing or if its layout differs.
+    Refuses to replace a file that is not a shared memory file.
+    """
+    path.parent.mkdir(parents=True, exist_ok=True)
+    while True:
+        try:
+            fd = os.open(path, os.O_RDWR)
+        except FileNotFoundError:
+            exists = False
+        else:
+            exists = True
+            file_header = os.pread(fd, _FILE_HEADER.size, 0)
+            if file_header == header and os.fstat(fd).st_size == size:
+                return fd
+            os.close(fd)
+            if file_header and file_header[: len(_FILE_MAGIC)] != _FILE_MAGIC:
+                raise ValueError(f'{path} is not a shared memory cache file')
+            logging.info('Replacing shared memory file %s with a new layout', path)
+
+        # Initialize aside and swap in atomically, never under another process
+        temp_path = path.with_name(f'.{path.name}.{os.getpid()}.tmp')
+        fd = os.open(temp_path, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o600)
+        try:
+            os.ftruncate(fd, size)
+            os.pwrite(fd, header, 0)
+            if exists:
+                os.replace(temp_path, path)
+            else:
+                os.link(temp_path, path)
+        except FileExistsError:
+            pass  # another process created it first
+        except BaseException:
+            os.close(fd)
+            raise
+        finally:
+            temp_path.unlink(missing_ok=True)
+
+        # Another process may have swapped in its own file concurrently
+        try:
+            if os.stat(path).st_ino == os.fstat(fd).st_ino:
+                return fd
+        except FileNotFoundError:
+            pass
+        os.close(fd)
+
+
+@cache
+def _get_shared_memory():
+    """Get the host-wide shared memory tier, or None if disabled."""
+    if not FILE_CACHE_SHARED_MEMORY_SIZE:
+        return None
+    return _SharedMemory(
+        FILE_CACHE_SHARED_MEMORY_PATH,
+        FILE_CACHE_SHARED_MEMORY_SIZE,
+        FILE_CACHE_SHARED_MEMORY_MAX_VALUE_SIZE,
+    )
+
 
 class _FileCacheLock:
     """A process-safe lock for file cache operations"""
@@ -54,8 +224,12 @@ class _FileCacheLock:
         lock_path = dir.joinpath(f'.{self.path.name}.lock')
         lock_file = self._file = lock_path.open('wb', buffering=0)
 
-        async with timeout(FILE_CACHE_LOCK_TIMEOUT.total_seconds()):
-            await to_thread(fcntl.flock, lock_file.fileno(), fcntl.LOCK_EX)
+        # Only hop to a thread when the lock is contended
+        try:
+            fcntl.flock(lock_file.fileno(), fcntl.LOCK_EX | fcntl.LOCK_NB)
+        except BlockingIOError:
+            async with timeout(FILE_CACHE_LOCK_TIMEOUT.total_seconds()):
+                await to_thread(fcntl.flock, lock_file.fileno(), fcntl.LOCK_EX)
 
         return self
 
@@ -66,11 +240,12 @@ class _FileCacheLock:
 
 
 class FileCache:
-    __slots__ = ('_base_dir', '_memory_cache')
+    __slots__ = ('_base_dir', '_memory_cache', '_shared_memory')
 
     def __init__(self, dirname: str, *, cache_dir: Path = FILE_CACHE_DIR):
         self._base_dir = cache_dir.joinpath(dirname)
         self._memory_cache = _MEMORY_CACHES.setdefault(self._base_dir, OrderedDict())
+        self._shared_memory = _get_shared_memory()
 
     async def get(self, key: StorageKey):
         """
@@ -92,6 +267,19 @@ class FileCache:
 
             self._memory_cache.pop(key)
 
+        shared = self._shared_memory
+        if shared is not None:
+            mentry = shared.get(self._digest(key))
+            if mentry is not None:
+                try:
+                    if (
+                        mentry.expires_at is None or mentry.expires_at > time()
+                    ) and path.stat().st_mtime == mentry.mtime:
+                        logging.debug('Cache hit for %r (shared memory)', key)
+                        return mentry.data
+                except OSError:
+                    pass
+
         try:
             with path.open('rb') as f:
                 entry_bytes = await to_thread(f.read)
@@ -111,10 +299,8 @@ class FileCache:
         else:
             expires_at = None
 
-        if not entry.volatile and len(entry.data) <= FILE_CACHE_MEMORY_MAX_VALUE_SIZE:
-            self._memory_cache[key] = _MemoryEntry(expires_at, entry.data, entry_mtime)
-            if len(self._memory_cache) > FILE_CACHE_MEMORY_MAX_ENTRIES:
-                self._memory_cache.popitem(False)
+        if not entry.volatile:
+            self._set_memory(key, _MemoryEntry(expires_at, entry.data, entry_mtime))
 
         logging.debug('Cache hit for %r (disk)', key)
         return entry.data
@@ -144,17 +330,16 @@ class FileCache:
         temp_path.replace(path)
 
         # Populate memory cache after successful write so mtime is accurate
-        if not volatile and len(data) <= FILE_CACHE_MEMORY_MAX_VALUE_SIZE:
-            self._memory_cache[lock.key] = _MemoryEntry(expires_at, data, mtime)
-            self._memory_cache.move_to_end(lock.key)
-            if len(self._memory_cache) > FILE_CACHE_MEMORY_MAX_ENTRIES:
-                self._memory_cache.popitem(False)
+        if not volatile:
+            self._set_memory(lock.key, _MemoryEntry(expires_at, data, mtime))
 
     def delete(self, key: StorageKey):
         """Delete a key from the file cache."""
         path = self._get_path(key)
         path.unlink(missing_ok=True)
         self._memory_cache.pop(key, None)
+        if self._shared_memory is not None:
+            self._shared_memory.set(self._digest(key), None)
 
     # TODO: runner, with lock
     # TODO: cleanup orphaned locks and temps
@@ -205,6 +390,29 @@ class FileCache:
             info.path.unlink(missing_ok=True)
             total_size -= info.size
 
+    def _set_memory(self, key: StorageKey, entry: _MemoryEntry, /):
+        """
+        Store the entry in shared memory if it fits, else in process memory.
+        Process memory is also used when the shared slot is busy.
+        """
+        shared = self._shared_memory
+        size = len(entry.data)
+        if (
+            shared is not None
+            and size <= shared.max_value_size
+            and shared.set(self._digest(key), entry)
+        ):
+            self._memory_cache.pop(key, None)
+        elif size <= FILE_CACHE_MEMORY_MAX_VALUE_SIZE:
+            self._memory_cache[key] = entry
+            self._memory_cache.move_to_end(key)
+            if len(self._memory_cache) > FILE_CACHE_MEMORY_MAX_ENTRIES:
+                self._memory_cache.popitem(False)
+
+    def _digest(self, key: StorageKey, /):
+        """Get the shared memory digest of a key, unique across cache directories."""
+        return blake2b(f'{self._base_dir}\0{key}'.encode(), digest_size=16).digest()
+
     def _get_path(self, key: StorageKey, /):
         """Get the path to a file in the cache."""
         return (
@@ -2,13 +2,18 @@ import logging
 import tarfile
 import zlib
 from abc import ABC, abstractmethod
-from asyncio import to_thread
+from asyncio import Condition, gather, get_running_loop, to_thread
 from bz2 import BZ2Decompressor
+from collections.abc import AsyncIterable, AsyncIterator, Callable
 from compression import zstd
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import asynccontextmanager
+from contextvars import copy_context
+from functools import partial
 from io import BytesIO
 from tarfile import TarError
-from typing import ClassVar, LiteralString, NamedTuple, override
-from zipfile import BadZipFile, ZipFile
+from typing import ClassVar, LiteralString, NamedTuple, TypeVar, override
+from zipfile import BadZipFile, ZipFile, ZipInfo
 
 import cython
 import magic
@@ -19,12 +24,17 @@ from app.config import (
     TRACE_FILE_COMPRESS_ZSTD_LEVEL,
     TRACE_FILE_COMPRESS_ZSTD_THREADS,
     TRACE_FILE_DECOMPRESSED_MAX_SIZE,
+    TRACE_FILE_EXTRACT_MEMORY_BUDGET,
+    TRACE_FILE_EXTRACT_WORKERS,
     TRACE_FILE_MAX_LAYERS,
 )
 from app.exceptions.context import raise_for
 from app.models.types import StorageKey
 
 
+_T = TypeVar('_T')
+
+
 class _CompressResult(NamedTuple):
     data: bytes
     suffix: LiteralString
@@ -32,6 +42,7 @@ class _CompressResult(NamedTuple):
 
 
 _ZSTD_SUFFIX = '.zst'
+_ZSTD_STREAM_CHUNK_SIZE = 256 * 1024
 _ZSTD_METADATA: dict[str, str] = {'zstd_level': str(TRACE_FILE_COMPRESS_ZSTD_LEVEL)}
 _ZSTD_OPTIONS: dict[int, int] = {
     zstd.CompressionParameter.compression_level: TRACE_FILE_COMPRESS_ZSTD_LEVEL,
@@ -41,13 +52,12 @@ _ZSTD_OPTIONS: dict[int, int] = {
 
 class TraceFile:
     @staticmethod
-    def extract(buffer: bytes):
+    async def extract_decode(buffer: bytes, decode: Callable[[bytes], _T]) -> list[_T]:
         """
-        Extract the trace files from the buffer.
-        The buffer may be compressed, in which case it will be decompressed first.
+        Extract the trace files from the buffer and decode each of them, off the event loop.
+        Zip members are decompressed and decoded in parallel on the extract worker pool,
+        limited by the per-process memory budget.
         """
-        # multiple layers allow to handle nested archives such as .tar.gz
-        # the use of range here is a cython optimization
         for layer in range(1, TRACE_FILE_MAX_LAYERS + 1):
             content_type = magic.from_buffer(buffer[:2048], mime=True)
             logging.debug('Trace file layer %d is %r', layer, content_type)
@@ -55,18 +65,27 @@ class TraceFile:
             # return if no processing needed
             if content_type in {'text/xml', 'application/xml', 'application/gpx+xml'}:
                 _log_decompressed_size(content_type, len(buffer))
-                return [buffer]
+                return [await _extract_member(buffer, len(buffer), decode)]
+
+            # zip members are compressed individually, decompress them in the workers
+            if content_type == _ZipProcessor.media_type:
+                members = await to_thread(_ZipProcessor.members, buffer)
+                return await gather(*(
+                    _extract_member(read, size, decode) for read, size in members
+                ))
 
             # get the appropriate processor
             processor = _TRACE_PROCESSORS.get(content_type)
             if processor is None:
                 raise_for.trace_file_unsupported_format(content_type)
 
-            result = processor.decompress(buffer)
+            result = await to_thread(processor.decompress, buffer)
 
             # list of files: finished
             if not isinstance(result, bytes):
-                return result
+                return await gather(*(
+                    _extract_member(data, len(data), decode) for data in result
+                ))
 
             # compressed blob: continue processing
             buffer = result
@@ -94,6 +113,41 @@ class TraceFile:
             else buffer
         )
 
+    @staticmethod
+    async def decompress_stream_if_needed(
+        chunks: AsyncIterable[bytes], file_id: StorageKey
+    ) -> AsyncIterator[bytes]:
+        """
+        Decompress the trace file chunks if needed.
+        Output is produced incrementally, in chunks of bounded size.
+        """
+        if not file_id.endswith(_ZSTD_SUFFIX):
+            async for chunk in chunks:
+                yield chunk
+            return
+
+        decompressor = zstd.ZstdDecompressor()
+        in_frame: cython.bint = False
+
+        async for chunk in chunks:
+            data = chunk
+            while data or (in_frame and not decompressor.needs_input):
+                # concatenated frames: continue with a fresh decompressor
+                if decompressor.eof:
+                    data = decompressor.unused_data
+                    decompressor = zstd.ZstdDecompressor()
+                    in_frame = False
+                    continue
+
+                in_frame = True
+                result = decompressor.decompress(data, _ZSTD_STREAM_CHUNK_SIZE)
+                data = b''
+                if result:
+                    yield result
+
+        if in_frame and not decompressor.eof:
+            raise zstd.ZstdError('Trace file is truncated')
+
 
 class _TraceProcessor(ABC):
     media_type: ClassVar[str]
@@ -183,44 +237,53 @@ class _TarProcessor(_TraceProcessor):
             raise_for.trace_file_archive_corrupted(cls.media_type)
 
 
-class _ZipProcessor(_TraceProcessor):
+class _ZipProcessor:
     media_type = 'application/zip'
 
     @classmethod
-    @override
-    def decompress(cls, buffer: bytes):
+    def members(cls, buffer: bytes) -> list[tuple[Callable[[], bytes], int]]:
+        """
+        List the archive files as (read, size) pairs, without decompressing them.
+        The read functions are thread-safe and return at most the declared size.
+        """
         try:
-            with ZipFile(BytesIO(buffer)) as archive:
-                result: list[bytes] = []
-                remaining_size: cython.size_t = TRACE_FILE_DECOMPRESSED_MAX_SIZE
+            archive = ZipFile(BytesIO(buffer))
+        except BadZipFile:
+            raise_for.trace_file_archive_corrupted(cls.media_type)
 
-                for info in archive.infolist():
-                    if info.is_dir():
-                        continue
+        result: list[tuple[Callable[[], bytes], int]] = []
+        total_size: cython.size_t = 0
 
-                    if len(result) >= TRACE_FILE_ARCHIVE_MAX_FILES:
-                        raise_for.trace_file_archive_too_many_files()
+        for info in archive.infolist():
+            if info.is_dir():
+                continue
 
-                    with archive.open(info) as f:
-                        file_data = f.read(remaining_size)
-                        remaining_size -= len(file_data)
-                        result.append(file_data)
-                        if remaining_size == 0 and f.read(1):
-                            raise_for.input_too_big(TRACE_FILE_DECOMPRESSED_MAX_SIZE)
+            if len(result) >= TRACE_FILE_ARCHIVE_MAX_FILES:
+                raise_for.trace_file_archive_too_many_files()
 
-                logging.debug(
-                    'Trace %r archive contains %d files',
-                    cls.media_type,
-                    len(result),
-                )
+            # zipfile validates the declared size and checksum while reading
+            total_size += info.file_size
+            if total_size > TRACE_FILE_DECOMPRESSED_MAX_SIZE:
+                raise_for.input_too_big(TRACE_FILE_DECOMPRESSED_MAX_SIZE)
 
-        except BadZipFile:
-            raise_for.trace_file_archive_corrupted(cls.media_type)
+            result.append((partial(cls._read_member, archive, info), info.file_size))
 
-        total_size = TRACE_FILE_DECOMPRESSED_MAX_SIZE - remaining_size
+        logging.debug(
+            'Trace %r archive contains %d files',
+            cls.media_type,
+            len(result),
+        )
         _log_decompressed_size(cls.media_type, total_size)
         return result
 
+    @classmethod
+    def _read_member(cls, archive: ZipFile, info: ZipInfo) -> bytes:
+        try:
+            with archive.open(info) as f:
+                return f.read()
+        except BadZipFile, zlib.error:
+            raise_for.trace_file_archive_corrupted(cls.media_type)
+
 
 class _ZstdProcessor(_TraceProcessor):
     media_type = 'application/zstd'
@@ -244,6 +307,56 @@ class _ZstdProcessor(_TraceProcessor):
         return result
 
 
+class _MemoryBudget:
+    """Limit the total size of the files being processed at once."""
+
+    __slots__ = ('_available', '_condition', '_size')
+
+    def __init__(self, size: int):
+        self._size = size
+        self._available = size
+        self._condition = Condition()
+
+    @asynccontextmanager
+    async def reserve(self, size: int):
+        # files larger than the budget are processed alone
+        size = min(size, self._size)
+        async with self._condition:
+            await self._condition.wait_for(lambda: self._available >= size)
+            self._available -= size
+        try:
+            yield
+        finally:
+            async with self._condition:
+                self._available += size
+                self._condition.notify_all()
+
+
+_EXTRACT_EXECUTOR = ThreadPoolExecutor(
+    TRACE_FILE_EXTRACT_WORKERS, thread_name_prefix='TraceExtract'
+)
+_EXTRACT_BUDGET = _MemoryBudget(TRACE_FILE_EXTRACT_MEMORY_BUDGET)
+
+
+async def _extract_member(
+    member: bytes | Callable[[], bytes],
+    size: int,
+    decode: Callable[[bytes], _T],
+) -> _T:
+    """Read and decode a single trace file on the extract worker pool."""
+    async with _EXTRACT_BUDGET.reserve(size):
+        # like to_thread, run in a copy of the context for raise_for
+        return await get_running_loop().run_in_executor(
+            _EXTRACT_EXECUTOR, copy_context().run, _read_decode, member, decode
+        )
+
+
+def _read_decode(
+    member: bytes | Callable[[], bytes], decode: Callable[[bytes], _T]
+) -> _T:
+    return decode(member() if callable(member) else member)
+
+
 @cython.cfunc
 def _log_decompressed_size(media_type: str, size: cython.size_t):
     logging.debug('Trace %r decompressed size is %s', media_type, sizestr(size))
@@ -255,7 +368,6 @@ _TRACE_PROCESSORS: dict[str, type[_TraceProcessor]] = {
         _Bzip2Processor,
         _GzipProcessor,
         _TarProcessor,
-        _ZipProcessor,
         _ZstdProcessor,
     )
 }
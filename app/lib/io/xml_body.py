@@ -34,3 +34,4 @@ def xml_body(path: str):
         return data
 
     return Depends(dependency)
+
@@ -1,5 +1,6 @@
 import logging
-from typing import Any, Literal, overload
+from collections.abc import Iterable
+from typing import Any, Literal, NoReturn, overload
 
 from pydantic import ByteSize
 from sizestr import sizestr
@@ -7,7 +8,7 @@ from sizestr import sizestr
 from app.config import XML_PARSE_MAX_SIZE
 from app.exceptions.context import raise_for
 from app.lib.render import format_style
-from speedup import xattr_json, xattr_xml, xml_parse, xml_unparse
+from speedup import XMLStreamParser, xattr_json, xattr_xml, xml_parse, xml_unparse
 
 
 class XMLToDict:
@@ -26,6 +27,28 @@ class XMLToDict:
         except ValueError as e:
             raise_for.bad_xml('data', str(e), xml_bytes)
 
+    @staticmethod
+    def parse_iter(chunks: Iterable[bytes]):
+        """
+        Incrementally parse XML chunks, yielding each top-level child as soon as it closes.
+        osmChange actions are yielded once per contained element.
+
+        >>> list(parse_iter([b'<osmChange><create><node id="-1"/>', b'<node id="-2"/></create></osmChange>']))
+        [('create', [('node', {'@id': -1})]), ('create', [('node', {'@id': -2})])]
+        """
+        parser = XMLStreamParser()
+        chunk = b''
+        offset: int = 0
+
+        try:
+            for chunk in chunks:
+                yield from parser.feed(chunk)
+                offset += len(chunk)
+            chunk = b''
+            yield from parser.close()
+        except ValueError as e:
+            _raise_bad_chunk('data', str(e), chunk, offset)
+
     @staticmethod
     @overload
     def unparse(d: dict[str, Any]) -> str: ...
@@ -43,6 +66,16 @@ class XMLToDict:
         return result
 
 
+def _raise_bad_chunk(name: str, message: str, chunk: bytes, offset: int) -> NoReturn:
+    """Report a streaming parse error with the failing chunk and its input offset."""
+    raise_for.bad_xml(
+        name,
+        f'{message} (in chunk at byte offset {offset})',
+        # Chunk boundaries may split multi-byte characters
+        chunk.decode(errors='replace').encode(),
+    )
+
+
 def get_xattr(*, is_json: bool | None = None):
     """
     Return a function to format attribute names.
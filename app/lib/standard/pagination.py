@@ -200,7 +200,7 @@ async def sp_paginate_query(
         'Invalid state cursor type'
     )
 
-    async with db() as conn:
+    async with db(replica=True) as conn:
         if state is None:
             snapshot_cursor_raw, snapshot_max_id = await _snapshot(
                 conn,
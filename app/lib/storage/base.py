@@ -1,4 +1,5 @@
 from abc import ABC, abstractmethod
+from collections.abc import AsyncIterator
 from typing import LiteralString
 
 from app.models.types import StorageKey
@@ -12,6 +13,10 @@ class StorageBase(ABC):
         """Load a file from storage by key."""
         ...
 
+    async def load_stream(self, key: StorageKey) -> AsyncIterator[bytes]:
+        """Load a file from storage by key, in chunks."""
+        yield await self.load(key)
+
     async def save(
         self, data: bytes, suffix: LiteralString, metadata: dict[str, str] | None = None
     ) -> StorageKey:
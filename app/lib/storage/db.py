@@ -1,10 +1,15 @@
+from collections.abc import AsyncIterator
 from typing import LiteralString, override
 
-from app.db import db_delete, db_fetchval, db_insert
+from psycopg import IsolationLevel
+
+from app.db import db, db_delete, db_fetchval, db_insert
 from app.lib.storage.base import StorageBase
 from app.models.types import StorageKey
 from speedup import buffered_rand_storage_key
 
+_STREAM_CHUNK_SIZE = 1024 * 1024
+
 
 class DBStorage(StorageBase):
     """Local file storage."""
@@ -29,6 +34,35 @@ class DBStorage(StorageBase):
             raise FileNotFoundError(f'File {key!r} not found in {self._context!r}')
         return data
 
+    @override
+    async def load_stream(self, key: StorageKey) -> AsyncIterator[bytes]:
+        context = self._context
+        offset = 1  # substring is 1-based
+
+        # Read all slices from the same snapshot
+        async with db(isolation_level=IsolationLevel.REPEATABLE_READ) as conn:
+            while True:
+                # Values stored out of line without compression (STORAGE EXTERNAL)
+                # are sliced without loading the whole value
+                data = await db_fetchval(
+                    bytes,
+                    t"""
+                        SELECT substring(data FROM {offset} FOR {_STREAM_CHUNK_SIZE})
+                        FROM file
+                        WHERE context = {context} AND key = {key}
+                    """,
+                    conn=conn,
+                )
+                if data is None:
+                    raise FileNotFoundError(
+                        f'File {key!r} not found in {self._context!r}'
+                    )
+                if data:
+                    yield data
+                if len(data) < _STREAM_CHUNK_SIZE:
+                    return
+                offset += _STREAM_CHUNK_SIZE
+
     @override
     async def save(
         self, data: bytes, suffix: LiteralString, metadata: dict[str, str] | None = None
@@ -1,3 +1,4 @@
+from collections.abc import AsyncIterator
 from typing import LiteralString, override
 
 import aioboto3
@@ -10,6 +11,7 @@ from app.services.cache_service import CacheContext, CacheService
 from speedup import buffered_rand_storage_key
 
 _S3 = aioboto3.Session()
+_STREAM_CHUNK_SIZE = 1024 * 1024
 
 
 class S3Storage(StorageBase):
@@ -37,6 +39,14 @@ class S3Storage(StorageBase):
             ttl=S3_CACHE_EXPIRE,
         )
 
+    @override
+    async def load_stream(self, key: StorageKey) -> AsyncIterator[bytes]:
+        # Streamed reads bypass the local cache, they are meant for large files
+        async with _S3.client('s3') as s3:
+            body = (await s3.get_object(Bucket=self._bucket, Key=key))['Body']
+            async for chunk in body.iter_chunks(_STREAM_CHUNK_SIZE):
+                yield chunk
+
     @override
     async def save(
         self, data: bytes, suffix: LiteralString, metadata: dict[str, str] | None = None
@@ -35,6 +35,7 @@ from app.config import (
 )
 from app.db import psycopg_pool_open
 from app.lib.audit import AuditService
+from app.lib.geo.node_location_store import NodeLocationStore
 from app.lib.http.client import HTTP, HTTP_INTERNAL
 from app.lib.http.element_type_convertor import ElementTypeConvertor
 from app.lib.telemetry import cython_detect, sentry  # noqa: F401  DO NOT REMOVE
@@ -46,6 +47,7 @@ from app.middlewares.limit_url_size_middleware import LimitUrlSizeMiddleware
 from app.middlewares.localhost_redirect_middleware import LocalhostRedirectMiddleware
 from app.middlewares.parallel_tasks_middleware import ParallelTasksMiddleware
 from app.middlewares.profiler_middleware import ProfilerMiddleware
+from app.middlewares.replica_lsn_middleware import ReplicaLSNMiddleware
 from app.middlewares.request_body_middleware import RequestBodyMiddleware
 from app.middlewares.request_context_middleware import RequestContextMiddleware
 from app.middlewares.subdomain_middleware import SubdomainMiddleware
@@ -58,6 +60,7 @@ from app.services.changeset_service import ChangesetService
 from app.services.element_spatial_service import ElementSpatialService
 from app.services.email_service import EmailService
 from app.services.image_proxy_service import ImageProxyService
+from app.services.rate_limit_service import RateLimitService
 from app.services.system_app_service import SystemAppService
 from app.services.test_service import TestService
 
@@ -111,6 +114,8 @@ async def lifespan(_):
             EmailService.context(),
             ChangesetService.context(),
             ElementSpatialService.context(),
+            RateLimitService.context(),
+            NodeLocationStore.context(),
         ):
             # freeze uncollected gc objects for improved performance
             gc.collect()
@@ -156,6 +161,7 @@ if ENV == 'dev':
 if ENV != 'prod':
     app.add_middleware(ProfilerMiddleware)
 
+app.add_middleware(ReplicaLSNMiddleware)  # depends on: request context
 app.add_middleware(RequestContextMiddleware)
 app.add_middleware(APICorsMiddleware)
 app.add_middleware(HeadersMiddleware)
@@ -1,5 +1,6 @@
 from starlette.types import ASGIApp, Receive, Scope, Send
 
+from app.db import db_batch
 from app.exceptions import Exceptions
 from app.exceptions.api06 import Exceptions06
 from app.exceptions.context import exceptions_context
@@ -13,7 +14,7 @@ _EXCEPTIONS_06 = Exceptions06()
 
 
 class ContextMiddleware:
-    """Wrap requests in exceptions, auth, translation and format contexts."""
+    """Wrap requests in exceptions, auth, translation, format and db batch contexts."""
 
     __slots__ = ('app',)
 
@@ -39,5 +40,6 @@ class ContextMiddleware:
             auth_context(*await AuthService.authenticate_request()),
             translation_context(None),
             format_style.style_context(),
+            db_batch(),
         ):
             return await self.app(scope, receive, send)
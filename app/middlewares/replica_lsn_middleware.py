@@ -0,0 +1,79 @@
+from contextvars import ContextVar
+from http.cookies import SimpleCookie
+from math import ceil
+
+import cython
+from starlette.datastructures import MutableHeaders
+from starlette.types import ASGIApp, Message, Receive, Scope, Send
+
+from app.config import ENV, POSTGRES_REPLICA_MAX_LAG, POSTGRES_REPLICA_URLS
+from app.middlewares.request_context_middleware import get_request
+
+_COOKIE_NAME = 'db_lsn'
+
+# Replicas lagging more than this are not read from, so by then the write is visible
+_COOKIE_MAX_AGE = ceil(POSTGRES_REPLICA_MAX_LAG.total_seconds())
+
+
+class _ClientLSN:
+    __slots__ = ('changed', 'lsn')
+
+    def __init__(self, lsn: int):
+        self.lsn = lsn
+        self.changed = False
+
+
+_CTX = ContextVar[_ClientLSN]('ClientLSN')
+
+
+def get_client_write_lsn() -> int:
+    """Get the primary LSN after the client's latest write, or 0."""
+    state = _CTX.get(None)
+    return state.lsn if state is not None else 0
+
+
+def set_client_write_lsn(lsn: int) -> None:
+    """Remember the primary LSN after the client's write, for its later requests."""
+    state = _CTX.get(None)
+    if state is not None and lsn > state.lsn:
+        state.lsn = lsn
+        state.changed = True
+
+
+class ReplicaLSNMiddleware:
+    """Carry the client's latest write LSN in a cookie, for read-your-writes on replicas."""
+
+    __slots__ = ('app',)
+
+    def __init__(self, app: ASGIApp):
+        self.app = app
+
+    async def __call__(self, scope: Scope, receive: Receive, send: Send):
+        if scope['type'] != 'http' or not POSTGRES_REPLICA_URLS:
+            return await self.app(scope, receive, send)
+
+        value = get_request().cookies.get(_COOKIE_NAME)
+        state = _ClientLSN(int(value) if value is not None and value.isdigit() else 0)
+
+        async def wrapper(message: Message):
+            # Writes finishing after the response has started are not carried over
+            if message['type'] == 'http.response.start' and state.changed:
+                MutableHeaders(scope=message).append(
+                    'Set-Cookie', _lsn_cookie(state.lsn)
+                )
+            await send(message)
+
+        with _CTX.set(state):
+            return await self.app(scope, receive, wrapper)
+
+
+@cython.cfunc
+def _lsn_cookie(lsn: int) -> str:
+    cookie = SimpleCookie()
+    cookie[_COOKIE_NAME] = str(lsn)
+    cookie[_COOKIE_NAME]['path'] = '/'
+    cookie[_COOKIE_NAME]['max-age'] = _COOKIE_MAX_AGE
+    cookie[_COOKIE_NAME]['secure'] = ENV != 'dev'
+    cookie[_COOKIE_NAME]['httponly'] = True
+    cookie[_COOKIE_NAME]['samesite'] = 'lax'
+    return cookie.output(header='').lstrip()
@@ -1,11 +1,12 @@
 import logging
+import re
 import zlib
 from compression import zstd
 from io import BytesIO
 
 import brotli
 import cython
-from fastapi import Response
+from fastapi import HTTPException, Response
 from sizestr import sizestr
 from starlette import status
 from starlette.types import ASGIApp, Message, Receive, Scope, Send
@@ -14,6 +15,10 @@ from app.config import REQUEST_BODY_MAX_SIZE
 from app.middlewares.request_context_middleware import get_request
 
 
+# Endpoints that read the body incrementally, with request_body_stream()
+_STREAMING_PATH_RE = re.compile(r'/api/0\.6/changeset/\d+/upload')
+
+
 class _TooBigError(ValueError):
     pass
 
@@ -36,6 +41,9 @@ class RequestBodyMiddleware:
         if scope['path'].startswith('/rpc/'):
             return await self.app(scope, receive, send)
 
+        if _STREAMING_PATH_RE.fullmatch(scope['path']) is not None:
+            return await self.app(scope, receive, send)
+
         req = get_request()
         input_size: cython.size_t = 0
         buffer = BytesIO()
@@ -61,7 +69,7 @@ class RequestBodyMiddleware:
 
             if decompressor is not None:
                 try:
-                    body = decompressor(body)
+                    body = _decompress(decompressor, body)
                 except _TooBigError:
                     return await Response(
                         f'Decompressed request body exceeded {sizestr(REQUEST_BODY_MAX_SIZE)}',
@@ -101,80 +109,176 @@ class RequestBodyMiddleware:
         return await self.app(scope, wrapper, send)
 
 
-def _decompress_zstd(buffer: bytes):
-    decompressor = zstd.ZstdDecompressor()
-    try:
-        result = decompressor.decompress(buffer, REQUEST_BODY_MAX_SIZE)
-    except zstd.ZstdError as e:
-        raise ValueError('Zstd stream is corrupted') from e
-
-    if not decompressor.eof:
-        if not decompressor.needs_input:
-            raise _TooBigError
-        raise ValueError('Zstd stream is corrupted')
-    if decompressor.unused_data:
-        raise ValueError('Zstd stream is corrupted')
-
-    return result
-
+async def request_body_stream():
+    """
+    Stream the decompressed request body, for endpoints matched by _STREAMING_PATH_RE.
+    The body size limit is enforced before and after decompression.
+    """
+    req = get_request()
+    content_encoding = req.headers.get('Content-Encoding')
+    decompressor = _get_decompressor(content_encoding)
+    input_size: cython.size_t = 0
+    output_size: cython.size_t = 0
+
+    async for chunk in req.stream():
+        input_size += len(chunk)
+        if input_size > REQUEST_BODY_MAX_SIZE:
+            raise HTTPException(
+                status.HTTP_413_CONTENT_TOO_LARGE,
+                f'Request body exceeded {sizestr(REQUEST_BODY_MAX_SIZE)}',
+            )
+
+        if decompressor is None:
+            if chunk:
+                yield chunk
+            continue
+
+        parts = decompressor.process(chunk)
+        while True:
+            try:
+                part = next(parts, None)
+            except Exception as e:
+                raise HTTPException(
+                    status.HTTP_400_BAD_REQUEST, 'Unable to decompress request body'
+                ) from e
+            if part is None:
+                break
 
-def _decompress_brotli(
-    buffer: bytes,
-    *,
-    chunk_size: cython.size_t = (1 << 16) - 1,
-):
-    decompressor = brotli.Decompressor()
+            output_size += len(part)
+            if output_size > REQUEST_BODY_MAX_SIZE:
+                raise HTTPException(
+                    status.HTTP_413_CONTENT_TOO_LARGE,
+                    f'Decompressed request body exceeded {sizestr(REQUEST_BODY_MAX_SIZE)}',
+                )
+            yield part
+
+    if decompressor is not None and input_size:
+        try:
+            decompressor.finish()
+        except Exception as e:
+            raise HTTPException(
+                status.HTTP_400_BAD_REQUEST, 'Unable to decompress request body'
+            ) from e
+
+        logging.debug(
+            'Streamed request body size: %s -> %s (compression: %s)',
+            sizestr(input_size),
+            sizestr(output_size),
+            content_encoding,
+        )
+    else:
+        logging.debug('Streamed request body size: %s', sizestr(input_size))
+
+
+# Upper bound of a single decompressed chunk, limiting the per-step memory usage
+_OUTPUT_CHUNK_SIZE = 1024 * 1024
+
+
+class _ZstdDecompressor:
+    __slots__ = ('_decompressor',)
+
+    def __init__(self):
+        self._decompressor = zstd.ZstdDecompressor()
+
+    def process(self, data: bytes):
+        decompressor = self._decompressor
+        if decompressor.eof:
+            raise ValueError('Zstd stream is corrupted')
+
+        try:
+            while True:
+                chunk = decompressor.decompress(data, _OUTPUT_CHUNK_SIZE)
+                data = b''
+                if chunk:
+                    yield chunk
+                if decompressor.eof:
+                    if decompressor.unused_data:
+                        raise ValueError('Zstd stream is corrupted')
+                    return
+                if decompressor.needs_input:
+                    return
+        except zstd.ZstdError as e:
+            raise ValueError('Zstd stream is corrupted') from e
+
+    def finish(self):
+        if not self._decompressor.eof:
+            raise ValueError('Zstd stream is corrupted')
+
+
+class _BrotliDecompressor:
+    __slots__ = ('_decompressor',)
+
+    def __init__(self):
+        self._decompressor = brotli.Decompressor()
+
+    def process(self, data: bytes):
+        decompressor = self._decompressor
+        while True:
+            # Unconsumed input is buffered by the decompressor until drained
+            chunk = decompressor.process(data, output_buffer_limit=_OUTPUT_CHUNK_SIZE)
+            data = b''
+            if chunk:
+                yield chunk
+            if decompressor.is_finished() or decompressor.can_accept_more_data():
+                return
+
+    def finish(self):
+        if not self._decompressor.is_finished():
+            raise ValueError('Brotli stream is corrupted')
+
+
+class _ZlibDecompressor:
+    __slots__ = ('_decompressor', '_name')
+
+    def __init__(self, wbits: int, name: str):
+        self._decompressor = zlib.decompressobj(wbits)
+        self._name = name
+
+    def process(self, data: bytes):
+        decompressor = self._decompressor
+        while data:
+            if decompressor.eof:
+                raise ValueError(f'{self._name} stream is corrupted')
+            chunk = decompressor.decompress(data, _OUTPUT_CHUNK_SIZE)
+            data = decompressor.unconsumed_tail
+            if chunk:
+                yield chunk
+
+        if decompressor.unused_data:
+            raise ValueError(f'{self._name} stream is corrupted')
+
+    def finish(self):
+        if not self._decompressor.eof:
+            raise ValueError(f'{self._name} stream is corrupted')
+
+
+_Decompressor = _ZstdDecompressor | _BrotliDecompressor | _ZlibDecompressor
+
+
+def _decompress(decompressor: _Decompressor, buffer: bytes):
     chunks: list[bytes] = []
     total_size: cython.size_t = 0
 
-    i: cython.size_t
-    for i in range(0, len(buffer), chunk_size):
-        chunk = decompressor.process(buffer[i : i + chunk_size])
-        chunks.append(chunk)
+    for chunk in decompressor.process(buffer):
         total_size += len(chunk)
         if total_size > REQUEST_BODY_MAX_SIZE:
             raise _TooBigError
+        chunks.append(chunk)
 
-    if not decompressor.is_finished():
-        raise ValueError('Brotli stream is corrupted')
-
+    decompressor.finish()
     return b''.join(chunks)
 
 
-def _decompress_gzip(buffer: bytes):
-    decompressor = zlib.decompressobj(zlib.MAX_WBITS | 16)
-    result = decompressor.decompress(buffer, REQUEST_BODY_MAX_SIZE)
-
-    if decompressor.unconsumed_tail:
-        raise _TooBigError
-    if not decompressor.eof or decompressor.unused_data:
-        raise ValueError('Gzip stream is corrupted')
-
-    return result
-
-
-def _decompress_zlib(buffer: bytes):
-    decompressor = zlib.decompressobj()
-    result = decompressor.decompress(buffer, REQUEST_BODY_MAX_SIZE)
-
-    if decompressor.unconsumed_tail:
-        raise _TooBigError
-    if not decompressor.eof or decompressor.unused_data:
-        raise ValueError('Zlib stream is corrupted')
-
-    return result
-
-
 @cython.cfunc
-def _get_decompressor(content_encoding: str | None):
+def _get_decompressor(content_encoding: str | None) -> _Decompressor | None:
     if content_encoding is None:
         return None
     if content_encoding == 'zstd':
-        return _decompress_zstd
+        return _ZstdDecompressor()
     if content_encoding == 'br':
-        return _decompress_brotli
+        return _BrotliDecompressor()
     if content_encoding == 'gzip':
-        return _decompress_gzip
+        return _ZlibDecompressor(zlib.MAX_WBITS | 16, 'Gzip')
     if content_encoding == 'deflate':
-        return _decompress_zlib
+        return _ZlibDecompressor(zlib.MAX_WBITS, 'Zlib')
     return None
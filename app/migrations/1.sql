@@ -0,0 +1,2 @@
+ALTER TABLE element_spatial_staging
+ALTER COLUMN depth TYPE integer;
@@ -0,0 +1,15 @@
+ALTER TABLE trace
+ADD COLUMN h3_cells h3index[];
+
+CREATE INDEX trace_h3_cells_idx ON trace USING gin (h3_cells)
+WITH
+    (fastupdate = FALSE);
+
+-- Keep indexing traces until they are backfilled (MigrationService.backfill_trace_h3_cells)
+DROP INDEX trace_segments_idx;
+
+CREATE INDEX trace_segments_idx ON trace USING gin (h3_points_to_cells_range (segments, 11))
+WITH
+    (fastupdate = FALSE)
+WHERE
+    h3_cells IS NULL;
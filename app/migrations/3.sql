@@ -0,0 +1,3 @@
+ALTER TABLE trace
+ADD COLUMN preview_line text,
+ADD COLUMN overview_line text;
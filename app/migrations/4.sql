@@ -0,0 +1,6 @@
+-- Files are mostly compressed already. Uncompressed out-of-line values let
+-- DBStorage.load_stream read slices without loading the whole value.
+-- Existing rows keep their storage until rewritten.
+ALTER TABLE file
+ALTER COLUMN data
+SET STORAGE EXTERNAL;
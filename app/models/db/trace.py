@@ -62,6 +62,9 @@ class TraceInit(TraceMetaInit):
     segments: Annotated[MultiLineString, GeometryValidator]
     elevations: list[float | None] | None
     capture_times: list[datetime | None] | None
+    # encoded polylines, None for traces not backfilled yet
+    preview_line: str | None
+    overview_line: str | None
 
 
 TraceMetaInitValidator = TypeAdapter(TraceMetaInit)
@@ -8,6 +8,7 @@ from shapely import MultiPolygon
 from shapely.geometry.base import BaseGeometry
 
 from app.db import (
+    DBLoader,
     db,
     db_count,
     db_fetchall,
@@ -173,15 +174,8 @@ class ChangesetCommentQuery:
             return
 
         id_map = {changeset['id']: changeset for changeset in changesets}
-        ids = list(id_map)
-
-        rows = await db_fetchrows(t"""
-            SELECT c.value, (
-                SELECT COUNT(*) FROM changeset_comment
-                WHERE changeset_id = c.value
-            ) FROM unnest({ids}) AS c(value)
-        """)
-        for changeset_id, count in rows:
+        counts = await _NUM_COMMENTS_LOADER.load_many(id_map)
+        for changeset_id, count in counts.items():
             id_map[changeset_id]['num_comments'] = count
 
     @staticmethod
@@ -251,13 +245,28 @@ class ChangesetBoundsQuery:
             return
 
         id_map = {changeset['id']: changeset for changeset in changesets}
-        ids = list(id_map)
-
-        rows: list[tuple[ChangesetId, MultiPolygon]] = await db_fetchrows(t"""
-            SELECT changeset_id, ST_Collect(bounds)
-            FROM changeset_bounds
-            WHERE changeset_id = ANY({ids})
-            GROUP BY changeset_id
-        """)
-        for changeset_id, bounds in rows:
+        changesets_bounds = await _BOUNDS_LOADER.load_many(id_map)
+        for changeset_id, bounds in changesets_bounds.items():
             id_map[changeset_id]['bounds'] = bounds
+
+
+async def _load_num_comments(ids: list[ChangesetId]) -> list[tuple]:
+    return await db_fetchrows(t"""
+        SELECT c.value, (
+            SELECT COUNT(*) FROM changeset_comment
+            WHERE changeset_id = c.value
+        ) FROM unnest({ids}) AS c(value)
+    """)
+
+
+async def _load_bounds(ids: list[ChangesetId]) -> list[tuple]:
+    return await db_fetchrows(t"""
+        SELECT changeset_id, ST_Collect(bounds)
+        FROM changeset_bounds
+        WHERE changeset_id = ANY({ids})
+        GROUP BY changeset_id
+    """)
+
+
+_NUM_COMMENTS_LOADER = DBLoader[ChangesetId, int](_load_num_comments)
+_BOUNDS_LOADER = DBLoader[ChangesetId, MultiPolygon](_load_bounds)
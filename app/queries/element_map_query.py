@@ -0,0 +1,531 @@
+import logging
+from asyncio import Lock, TaskGroup
+from collections import OrderedDict
+from collections.abc import AsyncIterator, Iterable
+from contextlib import aclosing
+from math import floor
+from time import monotonic
+from typing import NamedTuple, TypeAlias
+
+import cython
+import numpy as np
+from shapely import Point, Polygon, box, get_coordinates
+from shapely.geometry.base import BaseGeometry
+
+from app.config import (
+    MAP_QUERY_CACHE_DENSE_EXPIRE,
+    MAP_QUERY_CACHE_MAX_BBOX_TILES,
+    MAP_QUERY_CACHE_MAX_SIZE,
+    MAP_QUERY_CACHE_MAX_TILES,
+    MAP_QUERY_CACHE_SYNC_LIMIT,
+    MAP_QUERY_CACHE_TILE_ZOOM,
+    MAP_QUERY_LEGACY_NODES_LIMIT,
+)
+from app.db import db_fetchrows
+from app.exceptions.context import raise_for
+from app.models.db.element import Element
+from app.models.element import (
+    TYPED_ELEMENT_ID_NODE_MAX,
+    TYPED_ELEMENT_ID_RELATION_MIN,
+    TYPED_ELEMENT_ID_WAY_MAX,
+    TYPED_ELEMENT_ID_WAY_MIN,
+    TypedElementId,
+)
+from app.models.types import SequenceId
+from app.queries.element_query import ElementQuery
+
+_TileKey: TypeAlias = tuple[int, int]
+
+# Tiles use an equal-degree grid with the same column count as web mercator tiles
+_TILE_SIZE = 360 / (1 << MAP_QUERY_CACHE_TILE_ZOOM)
+
+# Rough memory estimates of the cached element dicts, in bytes
+_ELEMENT_SIZE_ESTIMATE = 1024
+_MEMBER_SIZE_ESTIMATE = 48
+_TAG_SIZE_ESTIMATE = 128
+
+
+class _Tile(NamedTuple):
+    sequence_id: SequenceId
+    elements: list[Element]
+    refs: frozenset[TypedElementId]
+    size: int  # estimated memory usage
+
+
+class _Change(NamedTuple):
+    typed_id: TypedElementId
+    point: Point | None
+    members: list[TypedElementId] | None
+
+
+class ElementMapQuery:
+    @staticmethod
+    async def find_by_geom(
+        geometry: BaseGeometry,
+        *,
+        partial_ways: bool = False,
+        include_relations: bool = True,
+        nodes_limit: int | None = None,
+        legacy_nodes_limit: bool = False,
+    ) -> list[Element]:
+        """
+        Find elements within the given geometry, using the tile cache when possible.
+        See ElementQuery.find_by_geom for the matching rules.
+        """
+        return [
+            element
+            async for elements in ElementMapQuery.iter_by_geom(
+                geometry,
+                partial_ways=partial_ways,
+                include_relations=include_relations,
+                nodes_limit=nodes_limit,
+                legacy_nodes_limit=legacy_nodes_limit,
+            )
+            for element in elements
+        ]
+
+    @staticmethod
+    async def iter_by_geom(
+        geometry: BaseGeometry,
+        *,
+        partial_ways: bool = False,
+        include_relations: bool = True,
+        nodes_limit: int | None = None,
+        legacy_nodes_limit: bool = False,
+    ) -> AsyncIterator[list[Element]]:
+        """
+        Find elements within the given geometry, yielding them in phases.
+        Small bboxes are merged from cached tiles, others fall back to ElementQuery.
+        See ElementQuery.iter_by_geom for the phases.
+        """
+        phases = await _find_by_tiles(
+            geometry,
+            partial_ways=partial_ways,
+            include_relations=include_relations,
+            nodes_limit=nodes_limit,
+            legacy_nodes_limit=legacy_nodes_limit,
+        )
+
+        if phases is None:
+            async with aclosing(
+                ElementQuery.iter_by_geom(
+                    geometry,
+                    partial_ways=partial_ways,
+                    include_relations=include_relations,
+                    nodes_limit=nodes_limit,
+                    legacy_nodes_limit=legacy_nodes_limit,
+                )
+            ) as chunks:
+                async for elements in chunks:
+                    yield elements
+            return
+
+        for elements in phases:
+            if elements:
+                yield elements
+
+
+_TILES = OrderedDict[_TileKey, _Tile]()
+_TILES_BY_REF: dict[TypedElementId, set[_TileKey]] = {}
+_TILES_SIZE: int = 0
+# Tiles over the nodes limit, mapped to the monotonic time their marker expires
+_DENSE_TILES = OrderedDict[_TileKey, float]()
+_SYNC_LOCK = Lock()
+_SYNC_STATE: dict[str, SequenceId] = {}
+
+
+async def _find_by_tiles(
+    geometry: BaseGeometry,
+    *,
+    partial_ways: bool,
+    include_relations: bool,
+    nodes_limit: int | None,
+    legacy_nodes_limit: bool,
+) -> list[list[Element]] | None:
+    """Merge the query result from cached tiles. Returns None if not cacheable."""
+    if not MAP_QUERY_CACHE_MAX_TILES or not isinstance(geometry, Polygon):
+        return None
+
+    # Tiles are merged by the bounds, so only rectangles are answered exactly
+    bounds: tuple[float, float, float, float] = geometry.bounds
+    if not geometry.equals(box(*bounds)):
+        return None
+
+    keys = _bounds_tile_keys(bounds)
+    if len(keys) > MAP_QUERY_CACHE_MAX_BBOX_TILES or _any_dense(keys):
+        return None
+
+    await _sync_changes()
+
+    tiles: dict[_TileKey, _Tile | None] = {key: _TILES.get(key) for key in keys}
+    missing = [key for key, tile in tiles.items() if tile is None]
+    if missing:
+        async with TaskGroup() as tg:
+
+            async def load_task(key: _TileKey):
+                tile = tiles[key] = await _load_tile(key)
+                if tile is not None:
+                    await _store_tile(key, tile)
+                else:
+                    _mark_dense(key)
+
+            for key in missing:
+                tg.create_task(load_task(key))
+
+    # Mark tiles as recently used
+    for key in keys:
+        if key in _TILES:
+            _TILES.move_to_end(key)
+
+    if any(tile is None for tile in tiles.values()):
+        return None
+
+    return _merge_tiles(
+        tiles.values(),  # type: ignore
+        bounds,
+        partial_ways=partial_ways,
+        include_relations=include_relations,
+        nodes_limit=nodes_limit,
+        legacy_nodes_limit=legacy_nodes_limit,
+    )
+
+
+@cython.cfunc
+def _merge_tiles(
+    tiles: Iterable[_Tile],
+    bounds: tuple[float, float, float, float],
+    *,
+    partial_ways: cython.bint,
+    include_relations: cython.bint,
+    nodes_limit: int | None,
+    legacy_nodes_limit: cython.bint,
+) -> list[list[Element]] | None:
+    """
+    Select the bbox closure from the union of the covering tiles' closures.
+    Returns the elements split into phases: nodes, ways' nodes, ways, relations.
+    """
+    by_ref: dict[TypedElementId, Element] = {}
+    for tile in tiles:
+        for element in tile.elements:
+            by_ref.setdefault(element['typed_id'], element)
+
+    # Match nodes within the bbox, the same way as the point && geometry condition
+    candidates = [
+        element
+        for typed_id, element in by_ref.items()
+        if typed_id <= TYPED_ELEMENT_ID_NODE_MAX and element['point'] is not None
+    ]
+    if not candidates:
+        return [[], [], [], []]
+
+    minx, miny, maxx, maxy = bounds
+    coords = get_coordinates([element['point'] for element in candidates])
+    x = coords[:, 0]
+    y = coords[:, 1]
+    mask = (x >= minx) & (x <= maxx) & (y >= miny) & (y <= maxy)
+    nodes = [candidates[i] for i in np.flatnonzero(mask).tolist()]
+    if not nodes:
+        return [[], [], [], []]
+
+    if legacy_nodes_limit and len(nodes) > MAP_QUERY_LEGACY_NODES_LIMIT:
+        raise_for.map_query_nodes_limit_exceeded()
+    if nodes_limit is not None and len(nodes) > nodes_limit:
+        del nodes[nodes_limit:]
+
+    nodes_refs = {node['typed_id'] for node in nodes}
+    ways = [
+        element
+        for typed_id, element in by_ref.items()
+        if TYPED_ELEMENT_ID_WAY_MIN <= typed_id <= TYPED_ELEMENT_ID_WAY_MAX
+        and (members := element['members'])
+        and not nodes_refs.isdisjoint(members)
+    ]
+
+    ways_nodes: list[Element] = []
+    if not partial_ways:
+        ways_nodes_refs = {
+            member
+            for way in ways
+            for member in way['members']  # type: ignore
+        }
+        ways_nodes_refs.difference_update(nodes_refs)
+        for member in ways_nodes_refs:
+            way_node = by_ref.get(member)
+            if way_node is None:
+                logging.warning('Map cache is missing way node %d', member)
+                return None
+            ways_nodes.append(way_node)
+
+    relations: list[Element] = []
+    if include_relations:
+        refs = nodes_refs.union(way['typed_id'] for way in ways)
+        relations = [
+            element
+            for typed_id, element in by_ref.items()
+            if typed_id >= TYPED_ELEMENT_ID_RELATION_MIN
+            and (members := element['members'])
+            and not refs.isdisjoint(members)
+        ]
+
+    # Callers annotate the elements in place, keep the cached ones intact
+    return [
+        [element.copy() for element in phase]
+        for phase in (nodes, ways_nodes, ways, relations)
+    ]
+
+
+async def _load_tile(key: _TileKey) -> _Tile | None:
+    """Compute the full closure of a tile. Returns None if the tile is too dense."""
+    # Read from the primary: a lagging replica could miss changes up to the stamp,
+    # which would never be replayed. Changes after it are replayed idempotently.
+    sequence_id = await ElementQuery.get_current_sequence_id()
+    elements: list[Element] = []
+
+    async with aclosing(
+        ElementQuery.iter_by_geom(
+            _tile_geometry(key),
+            nodes_limit=MAP_QUERY_LEGACY_NODES_LIMIT + 1,
+            replica=False,
+        )
+    ) as chunks:
+        async for chunk in chunks:
+            # The first chunk holds the matched nodes
+            if not elements and len(chunk) > MAP_QUERY_LEGACY_NODES_LIMIT:
+                return None
+            elements.extend(chunk)
+
+    refs = frozenset(element['typed_id'] for element in elements)
+    return _Tile(sequence_id, elements, refs, _estimate_size(elements))
+
+
+@cython.cfunc
+def _estimate_size(elements: list[Element]) -> int:
+    """Roughly estimate the memory used by the elements."""
+    size: int = len(elements) * _ELEMENT_SIZE_ESTIMATE
+    for element in elements:
+        members = element['members']
+        if members is not None:
+            size += len(members) * _MEMBER_SIZE_ESTIMATE
+        tags = element['tags']
+        if tags is not None:
+            size += len(tags) * _TAG_SIZE_ESTIMATE
+    return size
+
+
+@cython.cfunc
+def _any_dense(keys: list[_TileKey]) -> cython.bint:
+    """Check if any of the tiles is marked as too dense to cache."""
+    now = monotonic()
+    for key in keys:
+        expires_at = _DENSE_TILES.get(key)
+        if expires_at is not None:
+            if expires_at > now:
+                return True
+            del _DENSE_TILES[key]
+    return False
+
+
+@cython.cfunc
+def _mark_dense(key: _TileKey):
+    """Skip the tile cache for bboxes covering this tile, until the marker expires."""
+    _DENSE_TILES.pop(key, None)
+    _DENSE_TILES[key] = monotonic() + MAP_QUERY_CACHE_DENSE_EXPIRE.total_seconds()
+    while len(_DENSE_TILES) > MAP_QUERY_CACHE_MAX_TILES:
+        _DENSE_TILES.popitem(False)
+
+
+async def _store_tile(key: _TileKey, tile: _Tile) -> None:
+    """Store a computed tile, unless it was affected by already synced changes."""
+    checked_sequence_id = tile.sequence_id
+    while True:
+        synced_sequence_id = _SYNC_STATE.get('sequence_id')
+        if synced_sequence_id is None:
+            return
+        if checked_sequence_id >= synced_sequence_id:
+            break
+
+        # Changes between the tile computation and the last sync were not checked.
+        # Syncs may advance during the fetch, so repeat until caught up.
+        changes = await _fetch_changes(checked_sequence_id, synced_sequence_id)
+        if changes is None or any(
+            _is_tile_affected(key, tile.refs, change) for change in changes
+        ):
+            return
+        checked_sequence_id = synced_sequence_id
+
+    _insert_tile(key, tile)
+
+
+@cython.cfunc
+def _insert_tile(key: _TileKey, tile: _Tile):
+    global _TILES_SIZE
+    _evict_tile(key)
+    if tile.size > MAP_QUERY_CACHE_MAX_SIZE:
+        return
+
+    _TILES[key] = tile
+    _TILES_SIZE += tile.size
+    for ref in tile.refs:
+        keys = _TILES_BY_REF.get(ref)
+        if keys is None:
+            keys = _TILES_BY_REF[ref] = set()
+        keys.add(key)
+
+    while (
+        len(_TILES) > MAP_QUERY_CACHE_MAX_TILES
+        or _TILES_SIZE > MAP_QUERY_CACHE_MAX_SIZE
+    ):
+        _evict_tile(next(iter(_TILES)))
+
+
+@cython.cfunc
+def _evict_tile(key: _TileKey):
+    global _TILES_SIZE
+    tile = _TILES.pop(key, None)
+    if tile is None:
+        return
+
+    _TILES_SIZE -= tile.size
+    for ref in tile.refs:
+        keys = _TILES_BY_REF.get(ref)
+        if keys is not None:
+            keys.discard(key)
+            if not keys:
+                del _TILES_BY_REF[ref]
+
+
+async def _sync_changes() -> None:
+    """Evict tiles affected by the elements changed since the last sync."""
+    current_sequence_id = await ElementQuery.get_current_sequence_id()
+
+    # Callers queued behind a sync that already covers their state return early
+    async with _SYNC_LOCK:
+        synced_sequence_id = _SYNC_STATE.get('sequence_id')
+        if synced_sequence_id is None:
+            _SYNC_STATE['sequence_id'] = current_sequence_id
+            return
+        if synced_sequence_id >= current_sequence_id:
+            return
+
+        changes = await _fetch_changes(synced_sequence_id, current_sequence_id)
+        if changes is None:
+            logging.info('Map cache is too far behind, clearing all tiles')
+            _clear_tiles()
+        else:
+            affected: set[_TileKey] = set()
+            for change in changes:
+                affected.update(_change_tile_keys(change))
+            for key in affected:
+                _evict_tile(key)
+
+        _SYNC_STATE['sequence_id'] = current_sequence_id
+
+
+async def _fetch_changes(
+    after_sequence_id: SequenceId,
+    until_sequence_id: SequenceId,
+) -> list[_Change] | None:
+    """Fetch the elements changed in the sequence range. Returns None if too many."""
+    rows = await db_fetchrows(
+        t"""
+            SELECT typed_id, point, members FROM element
+            WHERE sequence_id > {after_sequence_id}
+            AND sequence_id <= {until_sequence_id}
+        """,
+        limit=MAP_QUERY_CACHE_SYNC_LIMIT + 1,
+    )
+    if len(rows) > MAP_QUERY_CACHE_SYNC_LIMIT:
+        return None
+    return [_Change(*row) for row in rows]
+
+
+@cython.cfunc
+def _clear_tiles():
+    global _TILES_SIZE
+    _TILES.clear()
+    _TILES_BY_REF.clear()
+    _TILES_SIZE = 0
+
+
+@cython.cfunc
+def _change_tile_keys(change: _Change) -> set[_TileKey]:
+    """Get the keys of cached tiles affected by the change."""
+    result: set[_TileKey] = set()
+
+    keys = _TILES_BY_REF.get(change.typed_id)
+    if keys is not None:
+        result.update(keys)
+
+    # New parents of cached elements
+    if change.members:
+        for member in change.members:
+            keys = _TILES_BY_REF.get(member)
+            if keys is not None:
+                result.update(keys)
+
+    # Nodes moved or added into cached tiles
+    if change.point is not None:
+        result.update(
+            key
+            for key in _point_tile_keys(change.point.x, change.point.y)
+            if key in _TILES
+        )
+
+    return result
+
+
+@cython.cfunc
+def _is_tile_affected(
+    key: _TileKey, refs: frozenset[TypedElementId], change: _Change
+) -> cython.bint:
+    return (
+        change.typed_id in refs
+        or (change.members is not None and not refs.isdisjoint(change.members))
+        or (
+            change.point is not None
+            and key in _point_tile_keys(change.point.x, change.point.y)
+        )
+    )
+
+
+@cython.cfunc
+def _tile_index(value: float, offset: float) -> int:
+    return floor((value + offset) / _TILE_SIZE)
+
+
+@cython.cfunc
+def _point_tile_keys(lon: float, lat: float) -> list[_TileKey]:
+    """Get the keys of tiles containing the point, including the boundaries."""
+    xs = _boundary_indices(lon, 180)
+    ys = _boundary_indices(lat, 90)
+    return [(x, y) for x in xs for y in ys]
+
+
+@cython.cfunc
+def _boundary_indices(value: float, offset: float) -> tuple[int, ...]:
+    index = _tile_index(value, offset)
+    # Points on the tile boundary belong to both neighbors
+    if index * _TILE_SIZE == value + offset:
+        return (index - 1, index)
+    return (index,)
+
+
+@cython.cfunc
+def _bounds_tile_keys(bounds: tuple[float, float, float, float]) -> list[_TileKey]:
+    minx, miny, maxx, maxy = bounds
+    return [
+        (x, y)
+        for x in range(_tile_index(minx, 180), _tile_index(maxx, 180) + 1)
+        for y in range(_tile_index(miny, 90), _tile_index(maxy, 90) + 1)
+    ]
+
+
+@cython.cfunc
+def _tile_geometry(key: _TileKey):
+    x, y = key
+    return box(
+        x * _TILE_SIZE - 180,
+        y * _TILE_SIZE - 90,
+        (x + 1) * _TILE_SIZE - 180,
+        (y + 1) * _TILE_SIZE - 90,
+    )
@@ -1,11 +1,19 @@
-from asyncio import TaskGroup
+from asyncio import Queue, QueueShutDown, TaskGroup, create_task
+from collections.abc import AsyncIterator
+from contextlib import aclosing
 from string.templatelib import Template
-from typing import Literal, assert_never
+from typing import Literal, TypeVar, assert_never
 
 from psycopg import AsyncConnection, IsolationLevel
+from psycopg.rows import dict_row
+from psycopg.sql import SQL
 from shapely.geometry.base import BaseGeometry
 
-from app.config import MAP_QUERY_LEGACY_NODES_LIMIT
+from app.config import (
+    MAP_QUERY_LEGACY_NODES_LIMIT,
+    MAP_QUERY_SINGLE_STATEMENT,
+    MAP_QUERY_STREAM_BATCH_SIZE,
+)
 from app.db import (
     db,
     db_fetchall,
@@ -30,6 +38,10 @@ from app.models.proto.shared_types import ElementType
 from app.models.types import ChangesetId, SequenceId
 from speedup import element_id
 
+_T = TypeVar('_T')
+
+_UNION_ALL = SQL(' UNION ALL ')
+
 
 class ElementQuery:
     @staticmethod
@@ -530,6 +542,42 @@ class ElementQuery:
 
         Results are deduplicated.
         """
+        return [
+            element
+            async for elements in ElementQuery.iter_by_geom(
+                geometry,
+                partial_ways=partial_ways,
+                include_relations=include_relations,
+                nodes_limit=nodes_limit,
+                legacy_nodes_limit=legacy_nodes_limit,
+            )
+            for element in elements
+        ]
+
+    @staticmethod
+    async def iter_by_geom(
+        geometry: BaseGeometry,
+        *,
+        partial_ways: bool = False,
+        include_relations: bool = True,
+        nodes_limit: int | None = None,
+        legacy_nodes_limit: bool = False,
+        replica: bool = True,
+    ) -> AsyncIterator[list[Element]]:
+        """
+        Find elements within the given geometry, yielding them in phases.
+        See find_by_geom for the matching rules.
+
+        Phases are yielded as soon as their queries finish, in order:
+        - nodes
+        - nodes' ways' nodes -- unless partial_ways
+        - nodes' ways
+        - nodes' and nodes' ways' relations -- if include_relations
+
+        The nodes limit is checked before the first phase is yielded.
+        Results are deduplicated across phases.
+        Queries run one phase ahead of the consumer, bounding the buffered phases.
+        """
         if legacy_nodes_limit:
             if nodes_limit != MAP_QUERY_LEGACY_NODES_LIMIT:
                 raise ValueError(
@@ -537,88 +585,25 @@ class ElementQuery:
                 )
             nodes_limit += 1  # to detect limit exceeded
 
-        async with db(isolation_level=IsolationLevel.REPEATABLE_READ) as conn:
-            # Find all matching nodes within the geometry
-            nodes = await db_fetchall(
-                Element,
-                t"""
-                    SELECT * FROM element
-                    WHERE typed_id <= 1152921504606846975
-                    AND point && {geometry}
-                    AND latest
-                """,
-                limit=nodes_limit,
-                conn=conn,
+        iter_phases = (
+            _iter_by_geom_statement
+            if MAP_QUERY_SINGLE_STATEMENT
+            else _iter_by_geom_queries
+        )
+        async with aclosing(
+            _read_ahead(
+                iter_phases(
+                    geometry,
+                    partial_ways=partial_ways,
+                    include_relations=include_relations,
+                    nodes_limit=nodes_limit,
+                    legacy_nodes_limit=legacy_nodes_limit,
+                    replica=replica,
+                )
             )
-            if not nodes:
-                return []
-
-            if legacy_nodes_limit and len(nodes) > MAP_QUERY_LEGACY_NODES_LIMIT:
-                raise_for.map_query_nodes_limit_exceeded()
-
-            nodes_typed_ids = [node['typed_id'] for node in nodes]
-            result_sequences: list[list[Element]] = [nodes]
-
-            async with TaskGroup() as tg:
-
-                async def fetch_parents(
-                    typed_ids: list[TypedElementId],
-                    parent_type: ElementType,
-                ):
-                    parents = await ElementQuery.find_parents_by_refs(
-                        typed_ids, conn, parent_type=parent_type, limit=None
-                    )
-                    result_sequences.append(parents)
-                    return parents
-
-                async def way_task():
-                    # fetch parent ways
-                    ways = await fetch_parents(nodes_typed_ids, 'way')
-                    if not ways:
-                        return
-
-                    # fetch ways' parent relations
-                    if include_relations:
-                        ways_typed_ids = [way['typed_id'] for way in ways]
-                        tg.create_task(fetch_parents(ways_typed_ids, 'relation'))
-
-                    # fetch ways' nodes
-                    if partial_ways:
-                        return
-
-                    ways_nodes_typed_ids = {
-                        member
-                        for way in ways
-                        if (members := way['members'])
-                        for member in members
-                    }
-                    ways_nodes_typed_ids.difference_update(nodes_typed_ids)
-                    ways_nodes = await ElementQuery.find_by_refs(
-                        list(ways_nodes_typed_ids),
-                        at_sequence_id=(
-                            await ElementQuery.get_current_sequence_id(conn)
-                        ),
-                        limit=len(ways_nodes_typed_ids),
-                    )
-                    result_sequences.append(ways_nodes)
-
-                tg.create_task(way_task())
-
-                if include_relations:
-                    tg.create_task(fetch_parents(nodes_typed_ids, 'relation'))
-
-        # Remove duplicates and preserve order
-        result_set = set[SequenceId]()
-        result: list[Element] = []
-
-        for elements in result_sequences:
-            for element in elements:
-                sequence_id = element['sequence_id']
-                if sequence_id not in result_set:
-                    result_set.add(sequence_id)
-                    result.append(element)
-
-        return result
+        ) as chunks:
+            async for elements in chunks:
+                yield elements
 
     @staticmethod
     async def get_last_visible_sequence_id(element: Element) -> SequenceId | None:
@@ -635,3 +620,207 @@ class ElementQuery:
                 WHERE typed_id = {typed_id} AND sequence_id > {sequence_id}
             """,
         )
+
+
+async def _iter_by_geom_statement(
+    geometry: BaseGeometry,
+    *,
+    partial_ways: bool,
+    include_relations: bool,
+    nodes_limit: int | None,
+    legacy_nodes_limit: bool,
+    replica: bool,
+) -> AsyncIterator[list[Element]]:
+    """
+    Compute the find_by_geom closure in a single statement, yielding each phase.
+    Rows are streamed in phase order, and each phase is yielded once complete.
+    """
+    limit_clause = t'LIMIT {nodes_limit}' if nodes_limit is not None else t''
+    # Skip the parent lookups when the nodes limit is exceeded
+    nodes_limit_clause = (
+        t'AND (SELECT COUNT(*) FROM nodes) <= {MAP_QUERY_LEGACY_NODES_LIMIT}'
+        if legacy_nodes_limit
+        else t''
+    )
+
+    selects: list[Template] = [t'SELECT 0 AS phase, * FROM nodes']
+    if not partial_ways:
+        selects.append(t"""
+            SELECT 1, * FROM element
+            WHERE typed_id = ANY(ARRAY(
+                SELECT UNNEST(members) FROM ways
+                EXCEPT
+                SELECT typed_id FROM nodes
+            ))
+            AND latest
+        """)
+    selects.append(t'SELECT 2, * FROM ways')
+    if include_relations:
+        selects.append(t"""
+            SELECT 3, * FROM element r
+            WHERE members && ARRAY(
+                SELECT typed_id FROM nodes
+                UNION ALL
+                SELECT typed_id FROM ways
+            )
+            AND typed_id >= 2305843009213693952
+            AND latest
+            {nodes_limit_clause:q}
+        """)
+    unions = _UNION_ALL.join(selects)
+
+    query = t"""
+        /*+ BitmapScan(w element_members_idx) BitmapScan(r element_members_idx) */
+        WITH nodes AS MATERIALIZED (
+            SELECT * FROM element
+            WHERE typed_id <= 1152921504606846975
+            AND point && {geometry}
+            AND latest
+            {limit_clause:q}
+        ),
+        ways AS MATERIALIZED (
+            SELECT * FROM element w
+            WHERE members && ARRAY(SELECT typed_id FROM nodes)
+            AND typed_id BETWEEN 1152921504606846976 AND 2305843009213693951
+            AND latest
+            {nodes_limit_clause:q}
+        )
+        {unions:q}
+        ORDER BY phase
+    """
+
+    phase: int = 0
+    elements: list[Element] = []
+
+    # Rows are streamed rather than fetched through a DECLARE cursor,
+    # which would move the planner hint away from the start of the statement
+    async with db(replica=replica) as conn:
+        cursor = conn.cursor(row_factory=dict_row)
+        async for row in cursor.stream(query, size=MAP_QUERY_STREAM_BATCH_SIZE):
+            row_phase: int = row.pop('phase')
+            if row_phase != phase:
+                if phase == 0:
+                    _check_nodes_limit(elements, legacy_nodes_limit)
+                if elements:
+                    yield elements
+                    elements = []
+                phase = row_phase
+            elements.append(row)  # type: ignore
+
+    if phase == 0:
+        _check_nodes_limit(elements, legacy_nodes_limit)
+    if elements:
+        yield elements
+
+
+def _check_nodes_limit(nodes: list[Element], legacy_nodes_limit: bool) -> None:
+    if legacy_nodes_limit and len(nodes) > MAP_QUERY_LEGACY_NODES_LIMIT:
+        raise_for.map_query_nodes_limit_exceeded()
+
+
+async def _read_ahead(chunks: AsyncIterator[_T]) -> AsyncIterator[_T]:
+    """
+    Consume the iterator in a background task, one item ahead of the caller.
+    Database connections held by the iterator are released as soon as it finishes,
+    while at most one finished item waits for the caller (e.g., a slow client).
+    """
+    queue = Queue[_T](maxsize=1)
+
+    async def produce():
+        try:
+            async with aclosing(chunks):  # type: ignore
+                async for chunk in chunks:
+                    await queue.put(chunk)
+        finally:
+            queue.shutdown()
+
+    task = create_task(produce())
+    try:
+        while True:
+            try:
+                chunk = await queue.get()
+            except QueueShutDown:
+                break
+            yield chunk
+        await task  # propagate errors
+    finally:
+        task.cancel()
+
+
+async def _iter_by_geom_queries(
+    geometry: BaseGeometry,
+    *,
+    partial_ways: bool,
+    include_relations: bool,
+    nodes_limit: int | None,
+    legacy_nodes_limit: bool,
+    replica: bool,
+) -> AsyncIterator[list[Element]]:
+    """Run the find_by_geom queries in one snapshot, yielding each phase."""
+    async with db(
+        isolation_level=IsolationLevel.REPEATABLE_READ, replica=replica
+    ) as conn:
+        # Find all matching nodes within the geometry
+        nodes = await db_fetchall(
+            Element,
+            t"""
+                SELECT * FROM element
+                WHERE typed_id <= 1152921504606846975
+                AND point && {geometry}
+                AND latest
+            """,
+            limit=nodes_limit,
+            conn=conn,
+        )
+        if not nodes:
+            return
+
+        _check_nodes_limit(nodes, legacy_nodes_limit)
+        yield nodes
+
+        nodes_typed_ids = [node['typed_id'] for node in nodes]
+        ways = await ElementQuery.find_parents_by_refs(
+            nodes_typed_ids, conn, parent_type='way', limit=None
+        )
+        ways_nodes: list[Element] = []
+        relations: list[Element] = []
+
+        async with TaskGroup() as tg:
+
+            async def ways_nodes_task():
+                nonlocal ways_nodes
+                ways_nodes_typed_ids = {
+                    member
+                    for way in ways
+                    if (members := way['members'])
+                    for member in members
+                }
+                # Skip nodes that were already yielded
+                ways_nodes_typed_ids.difference_update(nodes_typed_ids)
+                ways_nodes = await ElementQuery.find_by_refs(
+                    list(ways_nodes_typed_ids),
+                    at_sequence_id=await ElementQuery.get_current_sequence_id(conn),
+                    limit=len(ways_nodes_typed_ids),
+                )
+
+            async def relations_task():
+                nonlocal relations
+                # Single query for both parents: each relation is returned once
+                relations = await ElementQuery.find_parents_by_refs(
+                    [*nodes_typed_ids, *(way['typed_id'] for way in ways)],
+                    conn,
+                    parent_type='relation',
+                    limit=None,
+                )
+
+            if ways and not partial_ways:
+                tg.create_task(ways_nodes_task())
+            if include_relations:
+                tg.create_task(relations_task())
+
+        if ways_nodes:
+            yield ways_nodes
+        if ways:
+            yield ways
+        if relations:
+            yield relations
@@ -1,4 +1,7 @@
+from collections.abc import AsyncIterator
+from itertools import chain, repeat
 from string.templatelib import Template
+from typing import Literal
 
 import cython
 import numpy as np
@@ -6,12 +9,14 @@ from numpy.typing import NDArray
 from psycopg import IsolationLevel
 from psycopg.sql import SQL
 from shapely import (
-    MultiLineString,
     MultiPoint,
     MultiPolygon,
     Polygon,
     get_coordinates,
+    get_parts,
     intersects_xy,
+    linestrings,
+    multilinestrings,
     prepare,
 )
 
@@ -28,6 +33,7 @@ from app.exceptions.context import raise_for
 from app.lib.auth.context import auth_scopes, auth_user
 from app.lib.geo.h3 import polygon_to_h3
 from app.lib.geo.mercator import mercator
+from app.lib.geo.trace_preview import encode_overview_line, encode_preview_line
 from app.lib.io.trace_file import TraceFile
 from app.lib.storage import TRACE_STORAGE
 from app.lib.time.date_utils import utcnow
@@ -37,6 +43,13 @@ from app.queries.timescaledb_query import TimescaleDBQuery
 
 _UNION_ALL = SQL(' UNION ALL ')
 
+# All columns except the search-only h3_cells
+_TRACE_COLUMNS = SQL(
+    'id, user_id, name, description, tags, visibility, file_id, size,'
+    ' segments, elevations, capture_times, preview_line, overview_line,'
+    ' created_at, updated_at'
+)
+
 
 class TraceQuery:
     @staticmethod
@@ -48,7 +61,7 @@ class TraceQuery:
         trace = await db_fetchone(
             Trace,
             t"""
-                SELECT * FROM trace
+                SELECT {_TRACE_COLUMNS:q} FROM trace
                 WHERE id = {trace_id}
             """,
         )
@@ -66,22 +79,23 @@ class TraceQuery:
         return await db_fetchall(
             Trace,
             t"""
-                SELECT * FROM trace
+                SELECT {_TRACE_COLUMNS:q} FROM trace
                 WHERE id = ANY({ids})
             """,
         )
 
     @staticmethod
-    async def get_one_data_by_id(trace_id: TraceId) -> bytes:
+    async def stream_one_data_by_id(trace_id: TraceId) -> AsyncIterator[bytes]:
         """
-        Get a trace data file by id.
+        Stream a trace data file by id.
         Raises if the trace is not visible to the current user.
-        Returns the file bytes.
+        Returns the decompressed file chunks.
         """
         trace = await TraceQuery.get_by_id(trace_id)
-        file_buffer = await TRACE_STORAGE.load(trace['file_id'])
-        file_bytes = TraceFile.decompress_if_needed(file_buffer, trace['file_id'])
-        return file_bytes
+        file_id = trace['file_id']
+        return TraceFile.decompress_stream_if_needed(
+            TRACE_STORAGE.load_stream(file_id), file_id
+        )
 
     @staticmethod
     async def count_by_user(user_id: UserId) -> int:
@@ -132,7 +146,7 @@ class TraceQuery:
         # so it's inlined rather than passed via db_fetchall's limit kwarg.
         limit_clause: Template = t'LIMIT {limit}' if limit is not None else t''
         query = t"""
-            SELECT * FROM trace
+            SELECT {_TRACE_COLUMNS:q} FROM trace
             WHERE {where:q}
             ORDER BY id {order:q}
             {limit_clause:q}
@@ -156,19 +170,28 @@ class TraceQuery:
         legacy_offset: int | None = None,
     ) -> list[Trace]:
         """Find traces by geometry. Returns traces with segments intersecting the provided geometry."""
-        h3_cells = polygon_to_h3(geometry, max_resolution=11)
+        cells = polygon_to_h3(geometry, max_resolution=11)
         visibility = (
             ['identifiable', 'trackable']
             if identifiable_trackable
             else ['public', 'private']
         )
 
-        async with db(isolation_level=IsolationLevel.REPEATABLE_READ) as conn:
+        async with db(
+            isolation_level=IsolationLevel.REPEATABLE_READ, replica=True
+        ) as conn:
             chunks = await TimescaleDBQuery.get_chunks_ranges('trace', conn)
             unions = _UNION_ALL.join([
                 t"""(
-                    SELECT * FROM trace
-                    WHERE h3_points_to_cells_range(segments, 11) && {h3_cells}::h3index[]
+                    SELECT {_TRACE_COLUMNS:q} FROM trace
+                    WHERE (
+                        h3_cells && {cells}::h3index[]
+                        -- not yet backfilled traces, see MigrationService.backfill_trace_h3_cells
+                        OR (
+                            h3_cells IS NULL
+                            AND h3_points_to_cells_range(segments, 11) && {cells}::h3index[]
+                        )
+                    )
                     AND visibility = ANY({visibility})
                     AND id BETWEEN {chunk_start} AND {chunk_end}
                     ORDER BY id DESC
@@ -179,7 +202,7 @@ class TraceQuery:
             traces = await db_fetchall(
                 Trace,
                 t"""
-                    /*+ BitmapScan(trace trace_segments_idx) */
+                    /*+ BitmapScan(trace trace_h3_cells_idx trace_segments_idx) */
                     {unions:q}
                 """,
                 limit=limit,
@@ -190,52 +213,14 @@ class TraceQuery:
                 return []
 
         prepare(geometry)
-        filtered_traces: list[Trace] = []
-
-        points: NDArray[np.object_]
-        segment_indices: NDArray[np.integer]
-
-        for trace in traces:
-            points, segment_indices = get_coordinates(
-                trace['segments'].geoms,  # type: ignore
-                return_index=True,
-            )
-
-            # Reconstruct segments to contain only intersecting points
-            intersect_mask = intersects_xy(geometry, points)
-            new_points = points[intersect_mask]
-            if len(new_points) == 0:
-                continue
-            new_segment_indices = segment_indices[intersect_mask]
-            filtered_traces.append(trace)
-
-            split_indices = np.unique(new_segment_indices, return_index=True)[1][1:]
-            segments = np.split(new_points, split_indices)
-            trace['segments'] = MultiLineString(segments)
-
-            if identifiable_trackable:
-                # Reconstruct capture_times to match new segments
-                # Public/private visibility discards elevations and capture_times
-                elevations = trace['elevations']
-                if elevations is not None:
-                    elevations_arr = np.array(elevations, np.object_)
-                    trace['elevations'] = elevations_arr[intersect_mask].tolist()
-
-                capture_times = trace['capture_times']
-                if capture_times is not None:
-                    capture_times_arr = np.array(capture_times, np.object_)
-                    trace['capture_times'] = capture_times_arr[intersect_mask].tolist()
-
-        traces = filtered_traces
+        traces, lines = _clip_traces(
+            traces, geometry, with_attributes=identifiable_trackable
+        )
         if not traces or identifiable_trackable:
             return traces
 
         # For public/private, return a simplified representation
-        segments = MultiLineString([
-            line  #
-            for trace in traces
-            for line in trace['segments'].geoms
-        ])
+        segments = multilinestrings(lines)
         now = utcnow()
         simplified: Trace = {
             'id': TraceId(0),
@@ -249,11 +234,37 @@ class TraceQuery:
             'segments': segments,
             'elevations': None,
             'capture_times': None,
+            'preview_line': None,
+            'overview_line': None,
             'created_at': now,
             'updated_at': now,
         }
         return [simplified]
 
+    @staticmethod
+    async def resolve_preview_lines(traces: list[Trace]):
+        """Resolve listing preview lines for traces created before they were stored."""
+        traces = [trace for trace in traces if trace['preview_line'] is None]
+        if not traces:
+            return
+
+        await TraceQuery.resolve_coords(traces, limit_per_trace=100, resolution=None)
+        for trace in traces:
+            coords = trace['coords']  # type: ignore[reportTypedDictNotRequiredAccess]
+            trace['preview_line'] = encode_preview_line(coords)
+
+    @staticmethod
+    async def resolve_overview_lines(traces: list[Trace]):
+        """Resolve trace page lines for traces created before they were stored."""
+        traces = [trace for trace in traces if trace['overview_line'] is None]
+        if not traces:
+            return
+
+        await TraceQuery.resolve_coords(traces, limit_per_trace=500, resolution=None)
+        for trace in traces:
+            coords = trace['coords']  # type: ignore[reportTypedDictNotRequiredAccess]
+            trace['overview_line'] = encode_overview_line(coords)
+
     @staticmethod
     async def resolve_coords(
         traces: list[Trace],
@@ -304,3 +315,73 @@ class TraceQuery:
                 )
 
             trace_map[trace_id]['coords'] = coords
+
+
+def _clip_traces(
+    traces: list[Trace],
+    geometry: Polygon | MultiPolygon,
+    *,
+    with_attributes: cython.bint,
+) -> tuple[list[Trace], NDArray[np.object_]]:
+    """
+    Clip the traces to the prepared geometry, in a single pass over all their points.
+    Returns the intersecting traces and the concatenation of their clipped segments.
+    Segments left with fewer than 2 points are discarded.
+    """
+    num_traces = len(traces)
+    parts, part_trace = get_parts(
+        np.array([trace['segments'] for trace in traces], np.object_),
+        return_index=True,
+    )
+    points, point_part = get_coordinates(parts, return_index=True)
+    point_trace = part_trace[point_part]
+
+    # Keep intersecting points, then drop segments too short to form a line
+    mask = intersects_xy(geometry, points)
+    mask &= np.bincount(point_part[mask], minlength=len(parts))[point_part] >= 2
+    kept_part = point_part[mask]
+    if not len(kept_part):
+        return [], np.empty(0, np.object_)
+
+    # Geometry constructors require contiguous indices
+    kept_parts, line_index = np.unique(kept_part, return_inverse=True)
+    lines = linestrings(points[mask], indices=line_index)
+    kept_traces, trace_index = np.unique(part_trace[kept_parts], return_inverse=True)
+    trace_lines = multilinestrings(lines, indices=trace_index)
+
+    kept_traces_ = kept_traces.tolist()
+    result = [traces[i] for i in kept_traces_]
+    for trace, segments in zip(result, trace_lines.tolist()):
+        trace['segments'] = segments
+
+    # Public/private visibility discards elevations and capture_times
+    if with_attributes:
+        trace_sizes = np.bincount(point_trace, minlength=num_traces).tolist()
+        offsets = np.searchsorted(
+            point_trace[mask], np.arange(num_traces + 1)
+        ).tolist()
+        key: Literal['elevations', 'capture_times']
+        for key in ('elevations', 'capture_times'):
+            values = _flat_attribute(traces, key, trace_sizes)[mask]
+            for i, trace in zip(kept_traces_, result):
+                if trace[key] is not None:
+                    trace[key] = values[offsets[i] : offsets[i + 1]].tolist()
+
+    return result, lines
+
+
+def _flat_attribute(
+    traces: list[Trace],
+    key: Literal['elevations', 'capture_times'],
+    trace_sizes: list[int],
+) -> NDArray[np.object_]:
+    """Concatenate a per-point attribute of all traces, padding missing with None."""
+    result = np.empty(sum(trace_sizes), np.object_)
+    result[:] = list(
+        chain.from_iterable(
+            values if (values := trace[key]) is not None else repeat(None, size)
+            for trace, size in zip(traces, trace_sizes)
+        )
+    )
+    return result
+
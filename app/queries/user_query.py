@@ -1,6 +1,8 @@
+from collections import OrderedDict
 from datetime import datetime
 from ipaddress import ip_address, ip_network
 from string.templatelib import Template
+from time import monotonic
 from typing import Literal, TypedDict, assert_never
 
 from psycopg.sql import SQL, Identifier
@@ -9,8 +11,11 @@ from shapely import Point
 from app.config import (
     DELETED_USER_EMAIL_SUFFIX,
     NEARBY_USERS_RADIUS_METERS,
+    USER_DISPLAY_CACHE_EXPIRE,
+    USER_DISPLAY_CACHE_MAX_ENTRIES,
 )
 from app.db import (
+    DBLoader,
     db_fetchall,
     db_fetchcol,
     db_fetchone,
@@ -38,6 +43,63 @@ _USER_DISPLAY_SELECT = SQL(',').join([
 ])
 
 
+# Process-wide LRU of (expires_at, row). Rows are shared between requests and must
+# not be mutated. Invalidation is local to the process, others rely on the expiration.
+_USER_DISPLAY_CACHE: OrderedDict[UserId, tuple[float, UserDisplay]] = OrderedDict()
+_USER_DISPLAY_CACHE_GENERATION = 0
+
+
+async def _load_user_displays(ids: list[UserId]):
+    result: list[tuple[UserId, UserDisplay]] = []
+    missing: list[UserId] = []
+    now = monotonic()
+    for user_id in ids:
+        entry = _USER_DISPLAY_CACHE.get(user_id)
+        if entry is not None and entry[0] > now:
+            _USER_DISPLAY_CACHE.move_to_end(user_id)
+            result.append((user_id, entry[1]))
+        else:
+            missing.append(user_id)
+
+    if not missing:
+        return result
+
+    generation = _USER_DISPLAY_CACHE_GENERATION
+    rows = await db_fetchall(
+        UserDisplay,
+        t'SELECT {_USER_DISPLAY_SELECT:q} FROM "user" WHERE id = ANY({missing})',
+    )
+
+    # Skip caching rows that may have been invalidated during the query
+    cache: bool = (
+        USER_DISPLAY_CACHE_MAX_ENTRIES > 0
+        and generation == _USER_DISPLAY_CACHE_GENERATION
+    )
+    expires_at = monotonic() + USER_DISPLAY_CACHE_EXPIRE.total_seconds()
+    for row in rows:
+        user_id = row['id']
+        result.append((user_id, row))
+        if cache:
+            _USER_DISPLAY_CACHE[user_id] = (expires_at, row)
+            _USER_DISPLAY_CACHE.move_to_end(user_id)
+
+    while len(_USER_DISPLAY_CACHE) > USER_DISPLAY_CACHE_MAX_ENTRIES:
+        _USER_DISPLAY_CACHE.popitem(False)
+
+    return result
+
+
+async def _load_changeset_users(ids: list[ChangesetId]) -> list[tuple]:
+    return await db_fetchrows(t"""
+        SELECT id, user_id FROM changeset
+        WHERE id = ANY({ids})
+    """)
+
+
+_USER_DISPLAY_LOADER = DBLoader[UserId, UserDisplay](_load_user_displays)
+_CHANGESET_USER_LOADER = DBLoader[ChangesetId, UserId | None](_load_changeset_users)
+
+
 class UserQuery:
     @staticmethod
     async def find_by_id(user_id: UserId) -> User | None:
@@ -182,6 +244,13 @@ class UserQuery:
             limit=limit,
         )
 
+    @staticmethod
+    def invalidate_user_display(user_id: UserId):
+        """Drop the cached display information of the user, after it was changed."""
+        global _USER_DISPLAY_CACHE_GENERATION
+        _USER_DISPLAY_CACHE_GENERATION += 1
+        _USER_DISPLAY_CACHE.pop(user_id, None)
+
     @staticmethod
     async def resolve_users(
         items: list,
@@ -208,12 +277,13 @@ class UserQuery:
         if not id_map:
             return
 
-        select_sql = _USER_DISPLAY_SELECT if kind is UserDisplay else SQL('*')
-        ids = list(id_map)
-        rows = await db_fetchall(
-            User,
-            t'SELECT {select_sql:q} FROM "user" WHERE id = ANY({ids})',
-        )
+        if kind is UserDisplay:
+            rows = (await _USER_DISPLAY_LOADER.load_many(id_map)).values()
+        else:
+            ids = list(id_map)
+            rows = await db_fetchall(
+                User, t'SELECT * FROM "user" WHERE id = ANY({ids})'
+            )
         for row in rows:
             for item in id_map[row['id']]:
                 item[user_key] = row
@@ -233,14 +303,8 @@ class UserQuery:
             else:
                 list_.append(element)
 
-        changeset_ids = list(id_map)
-        rows = await db_fetchrows(t"""
-            SELECT id, user_id FROM changeset
-            WHERE id = ANY({changeset_ids})
-        """)
-        changeset_id: ChangesetId
-        user_id: UserId | None
-        for changeset_id, user_id in rows:
+        changeset_users = await _CHANGESET_USER_LOADER.load_many(id_map)
+        for changeset_id, user_id in changeset_users.items():
             if user_id is not None:
                 for element in id_map[changeset_id]:
                     element['user_id'] = user_id
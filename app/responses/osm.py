@@ -1,11 +1,13 @@
-from collections.abc import Callable, Coroutine
-from functools import wraps
+from collections.abc import AsyncIterable, Callable, Coroutine
+from functools import cache, wraps
 from typing import Any, ParamSpec, TypeVar, override
+from xml.sax.saxutils import escape
 
 import cython
 import orjson
 from fastapi import APIRouter, Response
 from fastapi.dependencies.utils import get_dependant
+from fastapi.responses import StreamingResponse
 from fastapi.routing import APIRoute, request_response
 
 from app.config import ATTRIBUTION_URL, COPYRIGHT, GENERATOR, LICENSE_URL
@@ -21,6 +23,8 @@ _JSON_ATTRS = {
     'license': LICENSE_URL,
 }
 
+_JSON_OPTIONS = orjson.OPT_SERIALIZE_NUMPY | orjson.OPT_UTC_Z
+
 _XML_ATTRS = {
     '@version': '0.6',
     '@generator': GENERATOR,
@@ -64,6 +68,67 @@ class OSMResponse(Response):
 
         raise NotImplementedError(f'Unsupported osm format style {style!r}')
 
+    @classmethod
+    def xml_envelope(cls) -> tuple[bytes, bytes]:
+        """
+        Get the (head, tail) bytes of the XML document root.
+        Used by endpoints that encode their content directly to XML bytes.
+        """
+        return _xml_envelope(cls.xml_root)
+
+    @staticmethod
+    def xml_response(content: bytes):
+        return Response(content, media_type='application/xml; charset=utf-8')
+
+    @classmethod
+    def stream_xml(cls, chunks: AsyncIterable[bytes], *, head: bytes = b''):
+        """
+        Stream pre-encoded XML chunks inside the document root.
+        The head bytes are written right after the root opening tag.
+        """
+        envelope_head, envelope_tail = cls.xml_envelope()
+
+        async def body():
+            yield envelope_head + head
+            async for chunk in chunks:
+                yield chunk
+            yield envelope_tail
+
+        return StreamingResponse(body(), media_type='application/xml; charset=utf-8')
+
+    @staticmethod
+    def stream_json(
+        chunks: AsyncIterable[list],
+        *,
+        head: dict | None = None,
+        key: str = 'elements',
+    ):
+        """
+        Stream list chunks as a single JSON array.
+        If head is given, the array is written under the key of the head object.
+        """
+        if head is None:
+            prefix = b'['
+            suffix = b']'
+        else:
+            if _is_json_attrs_path():
+                head = {**_JSON_ATTRS, **head}
+            prefix = orjson.dumps({**head, key: []}, option=_JSON_OPTIONS)
+            prefix = prefix[: prefix.rindex(b']')]
+            suffix = b']}'
+
+        async def body():
+            yield prefix
+            separator = b''
+            async for chunk in chunks:
+                if not chunk:
+                    continue
+                yield separator + orjson.dumps(chunk, option=_JSON_OPTIONS)[1:-1]
+                separator = b','
+            yield suffix
+
+        return StreamingResponse(body(), media_type='application/json; charset=utf-8')
+
 
 class OSMChangeResponse(OSMResponse):
     xml_root = 'osmChange'
@@ -82,18 +147,20 @@ _T = TypeVar('_T')
 
 
 @cython.cfunc
-def _serialize_json(content: Any):
+def _is_json_attrs_path() -> cython.bint:
     # include json attributes if api 0.6 and not notes
     path: str = get_request().url.path
-    if path.startswith('/api/0.6/') and not path.startswith('/api/0.6/notes'):
+    return path.startswith('/api/0.6/') and not path.startswith('/api/0.6/notes')
+
+
+@cython.cfunc
+def _serialize_json(content: Any):
+    if _is_json_attrs_path():
         if not isinstance(content, dict):
             raise TypeError(f'Invalid json content type {type(content)}')
         content = {**_JSON_ATTRS, **content}
 
-    encoded = orjson.dumps(
-        content,
-        option=orjson.OPT_SERIALIZE_NUMPY | orjson.OPT_UTC_Z,
-    )
+    encoded = orjson.dumps(content, option=_JSON_OPTIONS)
     return Response(encoded, media_type='application/json; charset=utf-8')
 
 
@@ -110,6 +177,18 @@ def _serialize_xml(xml_root: str, content: Any):
     return Response(encoded, media_type='application/xml; charset=utf-8')
 
 
+@cache
+def _xml_envelope(xml_root: str) -> tuple[bytes, bytes]:
+    entities = {'"': '&quot;'}
+    attrs = ''.join(
+        f' {k[1:]}="{escape(v, entities)}"'  #
+        for k, v in _XML_ATTRS.items()
+    )
+    head = f"<?xml version='1.0' encoding='UTF-8'?>\n<{xml_root}{attrs}>"
+    tail = f'</{xml_root}>\n'
+    return head.encode(), tail.encode()
+
+
 @cython.cfunc
 def _serialize_rss(content: Any):
     if not isinstance(content, bytes):
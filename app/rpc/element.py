@@ -45,6 +45,7 @@ from app.models.proto.shared_pb2 import (
 )
 from app.models.types import SequenceId
 from app.queries.changeset_query import ChangesetQuery
+from app.queries.element_map_query import ElementMapQuery
 from app.queries.element_query import ElementQuery
 from app.queries.user_query import UserQuery
 from speedup import split_typed_element_id, typed_element_id
@@ -66,7 +67,7 @@ class _Service(Service):
             nodes_limit = MAP_QUERY_LEGACY_NODES_LIMIT
             legacy_nodes_limit = True
 
-        elements = await ElementQuery.find_by_geom(
+        elements = await ElementMapQuery.find_by_geom(
             geometry,
             partial_ways=True,
             include_relations=False,
@@ -3,7 +3,6 @@ from string.templatelib import Template
 from typing import override
 
 from connectrpc.request import RequestContext
-from polyline_rs import encode_lonlat
 
 from app.config import TRACES_LIST_PAGE_SIZE
 from app.db import t_and
@@ -63,9 +62,7 @@ class _Service(Service):
 
         async with TaskGroup() as tg:
             tg.create_task(UserQuery.resolve_users(traces))
-            tg.create_task(
-                TraceQuery.resolve_coords(traces, limit_per_trace=100, resolution=90)
-            )
+            tg.create_task(TraceQuery.resolve_preview_lines(traces))
 
         response = GetPageResponse()
         response.state.CopyFrom(state)
@@ -77,7 +74,7 @@ class _Service(Service):
             entry.summary.tags.extend(trace['tags'])
             entry.summary.visibility = trace['visibility']
             entry.summary.size = trace['size']
-            entry.summary.preview_line = encode_lonlat(trace['coords'].tolist(), 0)  # type: ignore[reportTypedDictNotRequiredAccess]
+            entry.summary.preview_line = trace['preview_line']  # type: ignore
             entry.user.CopyFrom(user_proto(trace['user']))  # type: ignore[reportTypedDictNotRequiredAccess]
             entry.name = trace['name']
         return response
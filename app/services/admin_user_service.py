@@ -137,3 +137,6 @@ class AdminUserService:
                     )
             for op in audits:
                 await op(conn)
+
+        if 'display_name' in updates:
+            UserQuery.invalidate_user_display(user_id)
@@ -1,3 +1,4 @@
+from asyncio import CancelledError, Future, get_running_loop, shield
 from collections.abc import Awaitable, Callable
 from datetime import timedelta
 from typing import NewType
@@ -10,6 +11,9 @@ from app.models.types import StorageKey
 
 CacheContext = NewType('CacheContext', str)
 
+# In-process generations, awaited by concurrent callers of the same key
+_IN_FLIGHT: dict[tuple[CacheContext, StorageKey], Future[bytes]] = {}
+
 
 class CacheService:
     @staticmethod
@@ -24,29 +28,45 @@ class CacheService:
         """
         Get a value from the cache.
         If the value is not in the cache, call the async factory to obtain it.
-        Uses a simple locking mechanism to prevent duplicate generation.
+        Concurrent calls in a process share one generation,
+        and a file lock prevents duplicate generation across processes.
         """
         fc = _get_file_cache(context)
+        flight_key = (context, key)
 
-        # Try to get the cached value first
-        value = await fc.get(key)
-        if value is not None:
-            return value
-
-        # On cache miss, acquire a lock to prevent duplicate generation
-        async with fc.lock(key) as lock:
-            # Check again in case another process generated value while we were waiting
+        while True:
+            # Try to get the cached value first
             value = await fc.get(key)
             if value is not None:
                 return value
 
-            # No one else has generated it, so we'll do it
-            value = await factory()
-            if isinstance(value, tuple):
-                value, ttl = value
+            # Wait for the generation already running in this process
+            future = _IN_FLIGHT.get(flight_key)
+            if future is None:
+                break
+            try:
+                return await shield(future)
+            except CancelledError:
+                # The generating task was cancelled, try again
+                if future.cancelled():
+                    continue
+                raise
 
-            await fc.set(lock, value, ttl=ttl, volatile=volatile)
-            return value
+        future = _IN_FLIGHT[flight_key] = get_running_loop().create_future()
+        try:
+            value = await _generate(fc, key, factory, ttl, volatile)
+        except CancelledError:
+            future.cancel()
+            raise
+        except BaseException as e:
+            future.set_exception(e)
+            future.exception()  # mark as retrieved, there may be no waiters
+            raise
+        finally:
+            del _IN_FLIGHT[flight_key]
+
+        future.set_result(value)
+        return value
 
     @staticmethod
     def delete(context: CacheContext, key: StorageKey):
@@ -55,6 +75,29 @@ class CacheService:
         fc.delete(key)
 
 
+async def _generate(
+    fc: FileCache,
+    key: StorageKey,
+    factory: Callable[[], Awaitable[bytes | tuple[bytes, timedelta]]],
+    ttl: timedelta,
+    volatile: bool,
+) -> bytes:
+    # On cache miss, acquire a lock to prevent duplicate generation
+    async with fc.lock(key) as lock:
+        # Check again in case another process generated value while we were waiting
+        value = await fc.get(key)
+        if value is not None:
+            return value
+
+        # No one else has generated it, so we'll do it
+        value = await factory()
+        if isinstance(value, tuple):
+            value, ttl = value
+
+        await fc.set(lock, value, ttl=ttl, volatile=volatile)
+        return value
+
+
 _FILE_CACHES: dict[CacheContext, FileCache] = {}
 
 
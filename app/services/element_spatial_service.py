@@ -2,16 +2,29 @@ import asyncio
 import logging
 from asyncio import Event, Future, Semaphore, TaskGroup
 from contextlib import asynccontextmanager, nullcontext
+from itertools import count
 from math import ceil
 from random import uniform
 from time import monotonic
 
-import cython
+import numpy as np
+from psycopg import AsyncConnection
 from psycopg.errors import InternalError_
 from sentry_sdk import capture_exception
 from sentry_sdk.api import start_transaction
-
-from app.db import db, db_fetchrow, db_fetchval, db_insert, db_lock, without_indexes
+from shapely import LineString, Polygon, set_srid
+from shapely.geometry.base import BaseGeometry
+
+from app.db import (
+    db,
+    db_fetchcol,
+    db_fetchrow,
+    db_fetchval,
+    db_insert,
+    db_lock,
+    without_indexes,
+)
+from app.lib.geo.node_location_store import NodeLocationStore
 from app.lib.http.retry import retry
 from app.lib.telemetry.progress import progress
 from app.lib.telemetry.sentry import (
@@ -19,9 +32,11 @@ from app.lib.telemetry.sentry import (
     SENTRY_ELEMENT_SPATIAL_MONITOR_SLUG,
 )
 from app.lib.telemetry.testmethod import testmethod
+from app.models.element import TypedElementId
 from app.models.types import SequenceId
 from app.utils import calc_num_workers
 
+# Maximum number of times a relation is computed per update, bounds cycles
 _MAX_RELATION_NESTING_DEPTH = 15
 _AVG_MEMBERS_PER_RELATION = 15
 
@@ -30,8 +45,7 @@ _PROCESS_DONE_EVENT = Event()
 
 # - w n: avg ways per batch
 # - m node_point: avg nodes per way (LEFT JOIN hint unsupported: github.com/ossc-db/pg_hint_plan/issues/217)
-_BATCH_QUERY_WAYS = """
-/*+ NoSeqScan(w) Rows(w n #{ways_per_batch}) Rows(m node_point #10) */
+_CANDIDATE_WAYS_CTE = """
 WITH changed_node_ids AS (
     SELECT array_agg(typed_id) AS ids
     FROM element
@@ -50,7 +64,13 @@ candidate_ways AS (
         w.sequence_id BETWEEN {start_seq} AND {end_seq}
         OR ({include_node_overlap} AND w.members && n.ids)
       )
-),
+)"""
+
+_BATCH_QUERY_WAYS = (
+    """
+/*+ NoSeqScan(w) Rows(w n #{ways_per_batch}) Rows(m node_point #10) */"""
+    + _CANDIDATE_WAYS_CTE
+    + """,
 ways_with_geom AS (
     SELECT
         w.typed_id,
@@ -92,6 +112,17 @@ ways_with_geom AS (
 INSERT INTO element_spatial_staging (typed_id, sequence_id, updated_sequence_id, depth, geom)
 SELECT typed_id, sequence_id, {end_seq}, 0, geom FROM ways_with_geom
 """
+)
+
+# Way geometries are assembled in Python from the node location store
+_BATCH_QUERY_CANDIDATE_WAYS = (
+    """
+/*+ NoSeqScan(w) Rows(w n #{ways_per_batch}) */"""
+    + _CANDIDATE_WAYS_CTE
+    + """
+SELECT typed_id, sequence_id, members, visible FROM candidate_ways
+"""
+)
 
 # - r batch_rel_ids: 1 row per relation
 # - r m: avg members per batch
@@ -133,7 +164,7 @@ ready_rels AS (
     SELECT r.* FROM rels_rows r
     LEFT JOIN blocked_rel_ids b ON b.parent_id = r.typed_id
     WHERE NOT r.eligible
-       OR {depth} >= {max_depth}
+       OR {force}
        OR b.parent_id IS NULL
 ),
 needed_member_ids AS (
@@ -320,7 +351,6 @@ async def _update(
     parallelism_init: int | float = 1.5,
     ways_batch_size: int = 20_000,
     rels_batch_size: int = 1_000,
-    _MAX_RELATION_NESTING_DEPTH: cython.size_t = _MAX_RELATION_NESTING_DEPTH,
 ):
     """
     Update the element_spatial table with geometries and spatial indices for ways and relations.
@@ -331,12 +361,13 @@ async def _update(
     - Relations updated when: the relation itself changes OR any member node/way changes
     - Initial build (watermark=0): skip node→way cascading to avoid duplicate work
 
-    Multi-depth processing handles nested relations deterministically:
-    - Depth 0: Process ways (no dependencies)
-    - Depth 1+: Process relations iteratively by dependency depth until no more ready
+    Dependency-driven processing handles nested relations:
+    - Round 0: Process ways (no dependencies)
+    - Round 1+: Process relations as soon as none of their relation members are pending,
+      without waiting for the rest of the nesting level to finish
 
     Two-stage approach enables deadlock-free parallel batch processing:
-    1. Parallel batches write to element_spatial_staging across all depths (append-only, zero conflicts)
+    1. Parallel batches write to element_spatial_staging across all rounds (append-only, zero conflicts)
     2. Single atomic finalize operation merges all staged data → element_spatial at end
 
     Watermark tracks completion; crash restarts from last committed watermark.
@@ -371,69 +402,43 @@ async def _update(
         max_sequence,
     )
 
-    # Process all depths (0=ways, 1+=relations)
-    depth: cython.size_t
-    for depth in range(_MAX_RELATION_NESTING_DEPTH + 1):
-        if not await _process_depth(
-            depth=depth,
-            last_sequence=last_sequence,
-            max_sequence=max_sequence,
-            parallelism=parallelism,
-            batch_size=(ways_batch_size if depth == 0 else rels_batch_size),
-        ):
-            break
-
-        # Seed pending relations for the next depth
-        if depth < _MAX_RELATION_NESTING_DEPTH:
-            await _seed_pending_relations(
-                depth=depth,
-                last_sequence=last_sequence,
-                max_sequence=max_sequence,
-                parallelism=parallelism,
-                batch_size=ways_batch_size,
-            )
-
+    await _process_ways(
+        last_sequence=last_sequence,
+        max_sequence=max_sequence,
+        parallelism=parallelism,
+        batch_size=ways_batch_size,
+    )
+    await _seed_pending_relations(
+        last_sequence=last_sequence,
+        max_sequence=max_sequence,
+        parallelism=parallelism,
+        batch_size=ways_batch_size,
+    )
+    await _process_relations(
+        last_sequence=last_sequence,
+        max_sequence=max_sequence,
+        parallelism=parallelism,
+        batch_size=rels_batch_size,
+    )
     await _finalize_staging(max_sequence=max_sequence, last_sequence=last_sequence)
 
 
-async def _process_depth(
+async def _process_ways(
     *,
-    depth: int,
     last_sequence: int,
     max_sequence: int,
     parallelism: int,
     batch_size: int,
 ):
-    """Process a single depth of element_spatial updates. Returns True if progress was made."""
-    # Determine what to process and how many items
-    if depth:
-        # db(True) because element_spatial_pending_rels is UNLOGGED
-        async with db(True) as conn:
-            num_items = await db_fetchval(
-                int,
-                t'SELECT COUNT(*) FROM element_spatial_pending_rels',
-                conn=conn,
-            )
-            assert num_items is not None
-
-        if num_items == 0:
-            logging.debug('Depth %d: No relations to process', depth)
-            return False
-
-        logging.debug('Depth %d: Processing %d relations', depth, num_items)
-        rels_num_batches = await _materialize_pending_rels_batches(batch_size)
-        rels_last_batch_size = num_items - (batch_size * (rels_num_batches - 1))
-    else:
-        num_items = max_sequence - last_sequence
-        logging.debug('Depth 0: Processing %d changes', num_items)
-        rels_num_batches = 0
-        rels_last_batch_size = 0
+    """Process way geometries (round 0), batched by sequence range."""
+    num_items = max_sequence - last_sequence
+    logging.debug('Round 0: Processing %d changes', num_items)
 
     semaphore = Semaphore(parallelism)
     include_node_overlap = 'TRUE' if last_sequence else 'FALSE'
 
     with (
-        progress(desc=f'element_spatial_staging depth={depth}', total=num_items)
+        progress(desc='element_spatial_staging ways', total=num_items)
         if last_sequence == 0
         else nullcontext()
     ) as advance:
@@ -442,102 +447,347 @@ async def _process_depth(
             batch_items = end_seq - start_seq + 1
             ways_per_batch = (batch_items + 4) // 5
             async with semaphore, db(True) as conn:
-                await conn.execute(
-                    _BATCH_QUERY_WAYS.format(  # type: ignore
+                # The store may be ahead of max_sequence: newer node changes
+                # are picked up again by the next update, but it must not lag
+                if (
+                    NodeLocationStore.enabled()
+                    and NodeLocationStore.sequence_id() >= max_sequence
+                ):
+                    await _process_ways_batch_store(
+                        conn,
                         ways_per_batch=ways_per_batch,
                         start_seq=start_seq,
                         end_seq=end_seq,
-                        max_sequence=max_sequence,
                         include_node_overlap=include_node_overlap,
                     )
-                )
+                else:
+                    await conn.execute(
+                        _BATCH_QUERY_WAYS.format(  # type: ignore
+                            ways_per_batch=ways_per_batch,
+                            start_seq=start_seq,
+                            end_seq=end_seq,
+                            max_sequence=max_sequence,
+                            include_node_overlap=include_node_overlap,
+                        )
+                    )
             if advance is not None:
                 advance(batch_items)
 
-        async def process_rels_batch(batch_id: int, batch_items: int):
-            async with semaphore, db(True) as conn:
-                await conn.execute(
-                    _BATCH_QUERY_RELATIONS.format(  # type: ignore
-                        members_per_rel=_AVG_MEMBERS_PER_RELATION,
-                        members_per_batch=batch_items * _AVG_MEMBERS_PER_RELATION,
-                        depth=depth,
-                        max_depth=_MAX_RELATION_NESTING_DEPTH,
-                        max_sequence=max_sequence,
-                        batch_id=batch_id,
-                        batch_items=batch_items,
+        async with TaskGroup() as tg:
+            for start_seq in range(last_sequence + 1, max_sequence + 1, batch_size):
+                end_seq = min(start_seq + batch_size - 1, max_sequence)
+                tg.create_task(process_ways_batch(start_seq, end_seq))
+
+    if num_items >= 10_000:
+        async with db(True) as conn:
+            await conn.execute('ANALYZE element_spatial_staging')
+
+
+async def _process_ways_batch_store(
+    conn: AsyncConnection,
+    *,
+    ways_per_batch: int,
+    start_seq: int,
+    end_seq: int,
+    include_node_overlap: str,
+):
+    """Stage way geometries, resolving node locations from the node location store."""
+    async with await conn.execute(
+        _BATCH_QUERY_CANDIDATE_WAYS.format(  # type: ignore
+            ways_per_batch=ways_per_batch,
+            start_seq=start_seq,
+            end_seq=end_seq,
+            include_node_overlap=include_node_overlap,
+        )
+    ) as r:
+        ways: list[tuple[int, int, list[TypedElementId] | None, bool]]
+        ways = await r.fetchall()  # type: ignore
+    if not ways:
+        return
+
+    typed_ids = [way[0] for way in ways]
+    sequence_ids = [way[1] for way in ways]
+    geoms = _build_way_geoms([
+        members if visible else None for _, _, members, visible in ways
+    ])
+    await conn.execute(t"""
+        INSERT INTO element_spatial_staging (typed_id, sequence_id, updated_sequence_id, depth, geom)
+        SELECT typed_id, sequence_id, {end_seq}, 0, geom
+        FROM UNNEST({typed_ids}::bigint[], {sequence_ids}::bigint[], {geoms}::geometry[])
+            AS t(typed_id, sequence_id, geom)
+    """)
+
+
+def _build_way_geoms(
+    ways_members: list[list[TypedElementId] | None],
+) -> list[BaseGeometry | None]:
+    """
+    Build way geometries from the latest node locations, matching _BATCH_QUERY_WAYS:
+    missing nodes and repeated points are skipped, closed simple rings become polygons.
+    """
+    num_members = [len(members) if members else 0 for members in ways_members]
+    coords = NodeLocationStore.get_coordinates([
+        member for members in ways_members if members for member in members
+    ])
+
+    result: list[BaseGeometry | None] = [None] * len(ways_members)
+    offset = 0
+    for i, n in enumerate(num_members):
+        way_coords = coords[offset : offset + n]
+        offset += n
+        way_coords = way_coords[~np.isnan(way_coords[:, 0])]
+        if way_coords.shape[0] < 2:
+            continue
+
+        # Like ST_RemoveRepeatedPoints, lines keep at least 2 points
+        repeated = (way_coords[1:] == way_coords[:-1]).all(axis=1)
+        if repeated.any():
+            unique_coords = way_coords[np.concatenate(([True], ~repeated))]
+            way_coords = (
+                unique_coords if unique_coords.shape[0] >= 2 else way_coords[[0, -1]]
+            )
+
+        line = LineString(way_coords)
+        result[i] = (
+            Polygon(way_coords)
+            if way_coords.shape[0] >= 4 and line.is_closed and line.is_simple
+            else line
+        )
+
+    return set_srid(np.array(result, dtype=object), 4326).tolist()
+
+
+async def _process_relations(
+    *,
+    last_sequence: int,
+    max_sequence: int,
+    parallelism: int,
+    batch_size: int,
+):
+    """
+    Process pending relations with a dependency-driven scheduler.
+
+    Every batch runs in its own round, numbered in start order, so a relation only
+    reads member geometries staged by rounds that finished before it was dispatched.
+    When a batch finishes, its relations leave the pending set and their parents
+    that became ready are dispatched immediately.
+
+    Relations that remain pending once the scheduler drains are blocked by cycles.
+    They are forced through, each relation being computed at most
+    _MAX_RELATION_NESTING_DEPTH times per update.
+    """
+    # db(True) because element_spatial_pending_rels is UNLOGGED
+    async with db(True) as conn:
+        num_items = await db_fetchval(
+            int,
+            t'SELECT COUNT(*) FROM element_spatial_pending_rels',
+            conn=conn,
+        )
+        assert num_items is not None
+
+    if num_items == 0:
+        logging.debug('No relations to process')
+        return
+
+    logging.debug('Processing %d relations', num_items)
+    semaphore = Semaphore(parallelism)
+    rounds = count(1)
+    dispatched: set[int] = set()
+    is_incremental = last_sequence > 0
+
+    with (
+        progress(desc='element_spatial_staging relations', total=num_items)
+        if last_sequence == 0
+        else nullcontext()
+    ) as advance:
+
+        async def process_rels_batch(
+            batch_id: int | None,
+            typed_ids: list[int] | None,
+            batch_items: int,
+            *,
+            force: bool,
+        ):
+            async with semaphore:
+                async with db(True) as conn:
+                    # Round numbers are assigned in start order,
+                    # after any member batches
+                    round_id = next(rounds)
+                    if batch_id is None:
+                        batch_id = round_id
+                        await conn.execute(t"""
+                            INSERT INTO element_spatial_pending_rels_batch (batch_id, typed_ids)
+                            VALUES ({batch_id}, {typed_ids})
+                        """)
+
+                    await conn.execute(
+                        _BATCH_QUERY_RELATIONS.format(  # type: ignore
+                            members_per_rel=_AVG_MEMBERS_PER_RELATION,
+                            members_per_batch=batch_items * _AVG_MEMBERS_PER_RELATION,
+                            depth=round_id,
+                            force='TRUE' if force else 'FALSE',
+                            max_sequence=max_sequence,
+                            batch_id=batch_id,
+                            batch_items=batch_items,
+                        )
                     )
-                )
+                    await _complete_rels_round(
+                        round_id, seed_parents=is_incremental, conn=conn
+                    )
+
+                # Check readiness after the commit, so that concurrent rounds
+                # completing members of the same parent see each other's deletes
+                dispatch(await _find_ready_rels(round_id, dispatched=dispatched))
+
+            if typed_ids is not None:
+                dispatched.difference_update(typed_ids)
             if advance is not None:
                 advance(batch_items)
 
-        async with TaskGroup() as tg:
-            if depth == 0:
-                # Depth 0: Batch by sequence range
-                for start_seq in range(last_sequence + 1, max_sequence + 1, batch_size):
-                    end_seq = min(start_seq + batch_size - 1, max_sequence)
-                    tg.create_task(process_ways_batch(start_seq, end_seq))
-            else:
-                # Depth 1+: Batch by pre-materialized batch_id
-                for batch_id in range(rels_num_batches):
+        def dispatch(typed_ids: list[int]):
+            # Concurrent rounds may report the same parent as ready
+            typed_ids = [
+                typed_id for typed_id in typed_ids if typed_id not in dispatched
+            ]
+            dispatched.update(typed_ids)
+            for i in range(0, len(typed_ids), batch_size):
+                chunk = typed_ids[i : i + batch_size]
+                tg.create_task(process_rels_batch(None, chunk, len(chunk), force=False))
+
+        force = False
+        while True:
+            # Batch ids of materialized batches are reserved as round numbers
+            first_batch_id = next(rounds)
+            num_batches, num_batch_items = await _materialize_pending_rels_batches(
+                batch_size,
+                first_batch_id=first_batch_id,
+                ready_only=not force,
+            )
+            rounds = count(first_batch_id + num_batches)
+
+            async with TaskGroup() as tg:
+                for i in range(num_batches):
                     batch_items = (
-                        rels_last_batch_size
-                        if batch_id == (rels_num_batches - 1)
+                        num_batch_items - batch_size * (num_batches - 1)
+                        if i == num_batches - 1
                         else batch_size
                     )
-                    tg.create_task(process_rels_batch(batch_id, batch_items))
+                    tg.create_task(
+                        process_rels_batch(
+                            first_batch_id + i, None, batch_items, force=force
+                        )
+                    )
+
+            # Drop relations that have reached the recomputation limit
+            async with db(True) as conn:
+                await conn.execute(t"""
+                    DELETE FROM element_spatial_pending_rels p
+                    WHERE (
+                        SELECT COUNT(*) FROM element_spatial_staging s
+                        WHERE s.typed_id = p.typed_id
+                          AND s.depth > 0
+                    ) >= {_MAX_RELATION_NESTING_DEPTH}
+                """)
+                num_blocked = await db_fetchval(
+                    int,
+                    t'SELECT COUNT(*) FROM element_spatial_pending_rels',
+                    conn=conn,
+                )
+                assert num_blocked is not None
+
+            if not num_blocked:
+                break
+
+            logging.debug('Forcing %d relations blocked by cycles', num_blocked)
+            force = True
+
+
+async def _complete_rels_round(
+    round_id: int,
+    *,
+    seed_parents: bool,
+    conn: AsyncConnection,
+):
+    """Remove the relations staged by the round from pending relations."""
+    await conn.execute(t"""
+        DELETE FROM element_spatial_pending_rels
+        WHERE typed_id IN (
+            SELECT typed_id
+            FROM element_spatial_staging
+            WHERE depth = {round_id}
+        )
+    """)
+
+    # Initial build (watermark=0): pending already contains all latest relations
+    if seed_parents:
+        await conn.execute(t"""
+            INSERT INTO element_spatial_pending_rels (typed_id)
+            SELECT typed_id FROM element
+            WHERE members && ARRAY(
+                SELECT typed_id FROM element_spatial_staging
+                WHERE depth = {round_id}
+              )
+              AND typed_id >= 2305843009213693952
+              AND latest
+              AND tags IS NOT NULL
+            ON CONFLICT DO NOTHING
+        """)
 
-    async with db(True) as conn:
-        if depth == 0:
-            if num_items >= 10_000:
-                await conn.execute('ANALYZE element_spatial_staging')
-
-        else:
-            rels_inserted = await db_fetchval(
-                int,
-                t"""
-                    SELECT COUNT(*) FROM element_spatial_staging
-                    WHERE depth = {depth}
-                """,
-                conn=conn,
-            )
-            if not rels_inserted:
-                logging.debug('Depth %d: No more progress is being made', depth)
-                return False
 
-    return True
+async def _find_ready_rels(round_id: int, *, dispatched: set[int]) -> list[int]:
+    """Find the parents of the round's relations that have no pending relation members left."""
+    exclude_ids = list(dispatched)
+    return await db_fetchcol(
+        int,
+        t"""
+        SELECT r.typed_id
+        FROM element r
+        INNER JOIN element_spatial_pending_rels p ON p.typed_id = r.typed_id
+        WHERE r.members && ARRAY(
+            SELECT typed_id FROM element_spatial_staging
+            WHERE depth = {round_id}
+          )
+          AND r.typed_id >= 2305843009213693952
+          AND r.latest
+          AND r.typed_id != ALL({exclude_ids})
+          AND (
+            NOT (r.visible AND r.tags IS NOT NULL)
+            OR NOT EXISTS (
+                SELECT 1
+                FROM UNNEST(r.members) AS m(member_id)
+                INNER JOIN element_spatial_pending_rels pr ON pr.typed_id = m.member_id
+                WHERE m.member_id >= 2305843009213693952
+            )
+          )
+          AND (
+            SELECT COUNT(*) FROM element_spatial_staging s
+            WHERE s.typed_id = r.typed_id
+              AND s.depth > 0
+          ) < {_MAX_RELATION_NESTING_DEPTH}
+        """,
+    )
 
 
 async def _seed_pending_relations(
     *,
-    depth: int,
     last_sequence: int,
     max_sequence: int,
     parallelism: int,
     batch_size: int,
 ):
     """Seed pending relations using parallel batched queries to avoid array_agg overflow."""
-    logging.debug('Seeding pending relations after depth %d', depth)
+    logging.debug('Seeding pending relations')
 
     async with db(True) as conn:
-        if depth == 0:
-            seq_start = last_sequence + 1
-            await conn.execute(t"""
-                INSERT INTO element_spatial_pending_rels (typed_id)
-                SELECT typed_id FROM element
-                WHERE sequence_id BETWEEN {seq_start} AND {max_sequence}
-                  AND typed_id >= 2305843009213693952
-                  AND latest
-                ON CONFLICT DO NOTHING
-            """)
-        else:
-            await conn.execute(t"""
-                DELETE FROM element_spatial_pending_rels
-                WHERE typed_id IN (
-                    SELECT typed_id
-                    FROM element_spatial_staging
-                    WHERE depth = {depth}
-                )
-            """)
+        seq_start = last_sequence + 1
+        await conn.execute(t"""
+            INSERT INTO element_spatial_pending_rels (typed_id)
+            SELECT typed_id FROM element
+            WHERE sequence_id BETWEEN {seq_start} AND {max_sequence}
+              AND typed_id >= 2305843009213693952
+              AND latest
+            ON CONFLICT DO NOTHING
+        """)
 
         # Initial build (watermark=0): pending already contains all latest relations via the
         # sequence-range insert above. Additional parent discovery via members overlap
@@ -549,32 +799,28 @@ async def _seed_pending_relations(
     semaphore = Semaphore(parallelism)
     num_items = max_sequence - last_sequence
 
-    with (
-        progress(desc='element_spatial_pending_rels', total=num_items)
-        if last_sequence == 0 and depth == 0
-        else nullcontext()
+    # Only incremental updates reach here, report at their log level
+    with progress(
+        desc='element_spatial_pending_rels', total=num_items, level=logging.DEBUG
     ) as advance:
 
         async def seed_from_element_batch_task(seq_start: int, seq_end: int):
             await _seed_from_element_batch(seq_start, seq_end, semaphore)
-            if advance is not None:
-                advance(seq_end - seq_start + 1)
+            advance(seq_end - seq_start + 1)
 
         async with TaskGroup() as tg:
-            if depth == 0:
-                # Nodes from element
-                for seq_start in range(last_sequence + 1, max_sequence + 1, batch_size):
-                    seq_end = min(seq_start + batch_size - 1, max_sequence)
-                    tg.create_task(seed_from_element_batch_task(seq_start, seq_end))
-
-            # Ways and relations from staging
-            num_batches = await _materialize_staging_batches(batch_size, depth=depth)
+            # Nodes from element
+            for seq_start in range(last_sequence + 1, max_sequence + 1, batch_size):
+                seq_end = min(seq_start + batch_size - 1, max_sequence)
+                tg.create_task(seed_from_element_batch_task(seq_start, seq_end))
+
+            # Ways from staging
+            num_batches = await _materialize_staging_batches(batch_size)
             for batch_id in range(num_batches):
                 tg.create_task(_seed_from_staging_batch(batch_id, semaphore))
 
-    if depth == 0:
-        async with db(True) as conn:
-            await conn.execute('ANALYZE element_spatial_pending_rels')
+    async with db(True) as conn:
+        await conn.execute('ANALYZE element_spatial_pending_rels')
 
 
 async def _seed_from_element_batch(seq_start: int, seq_end: int, semaphore: Semaphore):
@@ -596,7 +842,7 @@ async def _seed_from_element_batch(seq_start: int, seq_end: int, semaphore: Sema
         """)
 
 
-async def _materialize_staging_batches(batch_size: int, *, depth: int) -> int:
+async def _materialize_staging_batches(batch_size: int) -> int:
     """Materialize staging batches. Returns number of batches."""
     async with db(True) as conn:
         await conn.execute('TRUNCATE element_spatial_staging_batch')
@@ -606,7 +852,6 @@ async def _materialize_staging_batches(batch_size: int, *, depth: int) -> int:
                     typed_id,
                     ROW_NUMBER() OVER (ORDER BY typed_id) AS rn
                 FROM element_spatial_staging
-                WHERE {depth} = 0 OR depth = {depth}
             ),
             batched AS (
                 SELECT
@@ -628,35 +873,54 @@ async def _materialize_staging_batches(batch_size: int, *, depth: int) -> int:
         return num_batches
 
 
-async def _materialize_pending_rels_batches(batch_size: int) -> int:
-    """Materialize pending relation batches. Returns number of batches."""
+async def _materialize_pending_rels_batches(
+    batch_size: int,
+    *,
+    first_batch_id: int,
+    ready_only: bool,
+) -> tuple[int, int]:
+    """
+    Materialize pending relation batches, numbered from first_batch_id.
+    With ready_only, skip relations that have pending relation members.
+    Returns number of batches and number of relations.
+    """
     async with db(True) as conn:
-        await conn.execute('TRUNCATE element_spatial_pending_rels_batch')
-        await conn.execute(t"""
+        row = await db_fetchrow(
+            t"""
             WITH pending_rows AS (
                 SELECT
-                    typed_id,
-                    ROW_NUMBER() OVER (ORDER BY typed_id) AS rn
-                FROM element_spatial_pending_rels
+                    p.typed_id,
+                    ROW_NUMBER() OVER (ORDER BY p.typed_id) AS rn
+                FROM element_spatial_pending_rels p
+                WHERE NOT {ready_only}
+                   OR NOT EXISTS (
+                    SELECT 1
+                    FROM element r
+                    CROSS JOIN LATERAL UNNEST(r.members) AS m(member_id)
+                    INNER JOIN element_spatial_pending_rels pr ON pr.typed_id = m.member_id
+                    WHERE r.typed_id = p.typed_id
+                      AND r.latest
+                      AND r.visible
+                      AND r.tags IS NOT NULL
+                      AND m.member_id >= 2305843009213693952
+                   )
             ),
             batched AS (
+                INSERT INTO element_spatial_pending_rels_batch (batch_id, typed_ids)
                 SELECT
-                    ((rn - 1) / {batch_size})::INTEGER AS batch_id,
-                    ARRAY_AGG(typed_id) AS typed_ids
+                    {first_batch_id} + ((rn - 1) / {batch_size})::INTEGER,
+                    ARRAY_AGG(typed_id)
                 FROM pending_rows
-                GROUP BY batch_id
+                GROUP BY 1
+                RETURNING cardinality(typed_ids) AS batch_items
             )
-            INSERT INTO element_spatial_pending_rels_batch (batch_id, typed_ids)
-            SELECT batch_id, typed_ids FROM batched
-        """)
-
-        num_batches = await db_fetchval(
-            int,
-            t'SELECT COUNT(*) FROM element_spatial_pending_rels_batch',
+            SELECT COUNT(*), COALESCE(SUM(batch_items), 0)
+            FROM batched
+            """,
             conn=conn,
         )
-        assert num_batches is not None
-        return num_batches
+        assert row is not None
+        return row
 
 
 async def _seed_from_staging_batch(batch_id: int, semaphore: Semaphore):
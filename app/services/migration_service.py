@@ -7,6 +7,7 @@ from typing import NamedTuple
 
 from packaging.version import Version
 from psycopg import AsyncConnection
+from shapely import MultiLineString
 
 from app.config import ENV
 from app.db import (
@@ -18,7 +19,8 @@ from app.db import (
     db_insert,
 )
 from app.lib.auth.crypto import hash_bytes
-from app.models.types import ChangesetId
+from app.lib.geo.trace_preview import trace_preview_lines
+from app.models.types import ChangesetId, TraceId
 from app.services.admin_task_service import register_admin_task
 from app.utils import calc_num_workers
 
@@ -164,6 +166,94 @@ class MigrationService:
                 end_id = min(start_id + batch_size - 1, max_id)
                 tg.create_task(process_chunk(start_id, end_id))
 
+    @staticmethod
+    @register_admin_task
+    async def backfill_trace_h3_cells(
+        *,
+        parallelism: int | float = 2.0,
+        batch_size: int = 10_000,
+    ):
+        """Precompute the search H3 cells of traces created before the column existed."""
+        parallelism = calc_num_workers(parallelism)
+
+        max_id = await db_fetchval(int, t'SELECT COALESCE(MAX(id), 0) FROM trace')
+        assert max_id is not None
+
+        semaphore = Semaphore(parallelism)
+        logging.info(
+            'Backfilling trace H3 cells (batches=%d, parallelism=%d)',
+            ceil(max_id / batch_size),
+            parallelism,
+        )
+
+        async def process_chunk(start_id: int, end_id: int):
+            async with semaphore, db(True) as conn:
+                await conn.execute(t"""
+                    UPDATE trace
+                    SET h3_cells = h3_points_to_cells_range(segments, 11)
+                    WHERE id BETWEEN {start_id} AND {end_id}
+                    AND h3_cells IS NULL
+                """)
+
+        async with TaskGroup() as tg:
+            for start_id in range(1, max_id + 1, batch_size):
+                end_id = min(start_id + batch_size - 1, max_id)
+                tg.create_task(process_chunk(start_id, end_id))
+
+    @staticmethod
+    @register_admin_task
+    async def backfill_trace_preview_lines(
+        *,
+        parallelism: int | float = 2.0,
+        batch_size: int = 1_000,
+    ):
+        """Precompute the preview lines of traces created before the columns existed."""
+        parallelism = calc_num_workers(parallelism)
+
+        max_id = await db_fetchval(int, t'SELECT COALESCE(MAX(id), 0) FROM trace')
+        assert max_id is not None
+
+        semaphore = Semaphore(parallelism)
+        logging.info(
+            'Backfilling trace preview lines (batches=%d, parallelism=%d)',
+            ceil(max_id / batch_size),
+            parallelism,
+        )
+
+        async def process_chunk(start_id: int, end_id: int):
+            async with semaphore, db(True) as conn:
+                rows: list[tuple[TraceId, MultiLineString]] = await db_fetchrows(
+                    t"""
+                        SELECT id, segments FROM trace
+                        WHERE id BETWEEN {start_id} AND {end_id}
+                        AND (preview_line IS NULL OR overview_line IS NULL)
+                    """,
+                    conn=conn,
+                )
+                if not rows:
+                    return
+
+                ids = [trace_id for trace_id, _ in rows]
+                lines = [trace_preview_lines(segments) for _, segments in rows]
+                preview_lines = [line[0] for line in lines]
+                overview_lines = [line[1] for line in lines]
+                await conn.execute(t"""
+                    UPDATE trace SET
+                        preview_line = v.preview_line,
+                        overview_line = v.overview_line
+                    FROM unnest(
+                        {ids}::bigint[],
+                        {preview_lines}::text[],
+                        {overview_lines}::text[]
+                    ) AS v(id, preview_line, overview_line)
+                    WHERE trace.id = v.id
+                """)
+
+        async with TaskGroup() as tg:
+            for start_id in range(1, max_id + 1, batch_size):
+                end_id = min(start_id + batch_size - 1, max_id)
+                tg.create_task(process_chunk(start_id, end_id))
+
     @staticmethod
     async def cleanup_orphan_changesets_and_elements():
         async with db(True) as conn:
@@ -1,8 +1,8 @@
 from datetime import datetime
-from io import BytesIO
 
 import cython
 from psycopg import AsyncConnection
+from shapely import get_coordinates
 
 from app.db import db_fetchval, db_update
 from app.exceptions.optimistic_diff_error import OptimisticDiffError
@@ -16,7 +16,9 @@ from app.services.optimistic_diff.prepare import (
     ElementStateEntry,
     OptimisticDiffPrepare,
 )
-from speedup import element_type, typed_element_id
+from speedup import ElementCopyWriter, element_type, typed_element_id
+
+_COPY_CHUNK_SIZE = 10_000
 
 
 class OptimisticDiffApply:
@@ -267,33 +269,20 @@ async def _copy_elements(conn: AsyncConnection, elements: list[Element]):
             sequence_id, changeset_id,
             typed_id, version, latest,
             visible, tags, point, members, members_roles
-        ) FROM STDIN
+        ) FROM STDIN (FORMAT BINARY)
     """) as copy:
-        with BytesIO() as buffer:
-            write_row = copy.formatter.write_row
-
-            # This compiled check is slightly misleading.
-            # Cython will always use the first declaration.
-            if cython.compiled:
-                element: dict  # type: ignore
-            else:
-                element: Element
-
-            for element in elements:
-                data = write_row((
-                    element['sequence_id'],
-                    element['changeset_id'],
-                    element['typed_id'],
-                    element['version'],
-                    element['latest'],
-                    element['visible'],
-                    element['tags'],
-                    element['point'],
-                    element['members'],
-                    element['members_roles'],
-                ))
-                if data:
-                    buffer.write(data)
-
-            data = buffer.getvalue()
-            await copy.write(data)
+        # Stream in bounded chunks to limit the buffered COPY data
+        writer = ElementCopyWriter()
+        for i in range(0, len(elements), _COPY_CHUNK_SIZE):
+            chunk = elements[i : i + _COPY_CHUNK_SIZE]
+            chunk_points = [
+                point  #
+                for element in chunk
+                if (point := element['point']) is not None
+            ]
+            coords = get_coordinates(chunk_points).tobytes() if chunk_points else b''
+            writer.write_elements(chunk, coords)
+            await copy.write(writer.take())
+
+        writer.finish()
+        await copy.write(writer.take())
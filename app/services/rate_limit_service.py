@@ -1,20 +1,54 @@
 import logging
+from asyncio import TaskGroup, sleep
 from collections.abc import Callable
+from contextlib import asynccontextmanager
 from datetime import timedelta
 from random import random
+from time import monotonic
 
+import cython
 from fastapi import HTTPException
 from psycopg import AsyncConnection
 from starlette import status
 
-from app.config import RATE_LIMIT_CLEANUP_PROBABILITY
-from app.db import db, db_delete, db_insert
+from app.config import RATE_LIMIT_CLEANUP_PROBABILITY, RATE_LIMIT_SYNC_INTERVAL
+from app.db import db, db_delete, db_fetchrows, db_fetchval
 from app.lib.audit import audit
+from app.lib.http.retry import retry
 
 _DEFAULT_QUOTA_WINDOW = timedelta(hours=1)
 
 
+class _Bucket:
+    __slots__ = ('pending', 'rate', 'updated_at', 'usage')
+
+    def __init__(self, usage: float, rate: float):
+        self.usage = usage
+        self.rate = rate
+        self.updated_at = monotonic()
+        self.pending: float = 0  # usage not yet synced to the database
+
+    def leak(self, now: float) -> float:
+        self.usage = max(self.usage - (now - self.updated_at) * self.rate, 0)
+        self.updated_at = now
+        return self.usage
+
+
+# Process-local buckets, periodically reconciled with the shared rate_limit table
+_BUCKETS: dict[str, _Bucket] = {}
+
+
 class RateLimitService:
+    @staticmethod
+    @asynccontextmanager
+    async def context():
+        """Context manager for syncing rate limit usage to the database."""
+        async with TaskGroup() as tg:
+            task = tg.create_task(_sync_task())
+            yield
+            task.cancel()  # avoid "Task was destroyed" warning during tests
+        await _sync()
+
     @staticmethod
     async def update(
         key: str,
@@ -33,25 +67,18 @@ class RateLimitService:
         quota_per_second = quota / quota_window_seconds
 
         # Uses a leaky bucket algorithm where the usage decreases over time.
-        async with db(True) as conn:
-            row = await db_insert(
-                'rate_limit',
-                {'key': key, 'usage': change},
-                on_conflict=t"""(key) DO UPDATE SET
-                    usage = GREATEST(
-                        rate_limit.usage -
-                        EXTRACT(EPOCH FROM (statement_timestamp() - rate_limit.updated_at)) * {quota_per_second},
-                        0
-                    ) + EXCLUDED.usage,
-                    updated_at = DEFAULT""",
-                returning='usage',
-                conn=conn,
-            )
-            usage: float = row[0]
-
-            # probabilistic cleanup of expired entries
-            if random() < RATE_LIMIT_CLEANUP_PROBABILITY:
-                await _delete_expired(conn)
+        # Usage from other processes is picked up on the first use and on every sync.
+        bucket = _BUCKETS.get(key)
+        if bucket is None:
+            loaded = await _load_usage(key, quota_per_second)
+            bucket = _BUCKETS.get(key)
+            if bucket is None:
+                bucket = _BUCKETS[key] = _Bucket(loaded, quota_per_second)
+
+        bucket.rate = quota_per_second
+        usage = bucket.leak(monotonic()) + change
+        bucket.usage = usage
+        bucket.pending += change
 
         # Prepare headers
         quota_remaining = max(quota - usage, 0)
@@ -76,6 +103,93 @@ class RateLimitService:
         return headers
 
 
+async def _load_usage(key: str, quota_per_second: float) -> float:
+    usage = await db_fetchval(
+        float,
+        t"""
+        SELECT GREATEST(
+            usage -
+            EXTRACT(EPOCH FROM (statement_timestamp() - updated_at)) * {quota_per_second},
+            0
+        )::float8
+        FROM rate_limit
+        WHERE key = {key}
+        """,
+    )
+    return usage or 0
+
+
+@retry(None)
+async def _sync_task():
+    while True:
+        await sleep(RATE_LIMIT_SYNC_INTERVAL.total_seconds())
+        await _sync()
+
+
+async def _sync():
+    """Flush the aggregated local usage and adopt the global usage of the synced keys."""
+    # Sorted to lock rows in a consistent order across processes
+    dirty = sorted((k, b) for k, b in _BUCKETS.items() if b.pending)
+    if dirty:
+        keys = [k for k, _ in dirty]
+        changes = [b.pending for _, b in dirty]
+        rates = [b.rate for _, b in dirty]
+        for _, bucket in dirty:
+            bucket.pending = 0
+
+        try:
+            async with db(True) as conn:
+                rows = await db_fetchrows(
+                    t"""
+                    WITH input AS (
+                        SELECT * FROM unnest(
+                            {keys}::text[], {changes}::real[], {rates}::float8[]
+                        ) AS t(key, change, rate)
+                    )
+                    INSERT INTO rate_limit (key, usage)
+                    SELECT key, change FROM input
+                    ORDER BY key
+                    ON CONFLICT (key) DO UPDATE SET
+                        usage = GREATEST(
+                            rate_limit.usage -
+                            EXTRACT(EPOCH FROM (statement_timestamp() - rate_limit.updated_at)) *
+                            (SELECT rate FROM input WHERE input.key = EXCLUDED.key),
+                            0
+                        ) + EXCLUDED.usage,
+                        updated_at = DEFAULT
+                    RETURNING key, usage
+                    """,
+                    conn=conn,
+                )
+
+                # probabilistic cleanup of expired entries
+                if random() < RATE_LIMIT_CLEANUP_PROBABILITY:
+                    await _delete_expired(conn)
+        except BaseException:
+            # Keep the changes for the next sync
+            for (_, bucket), change in zip(dirty, changes, strict=True):
+                bucket.pending += change
+            raise
+
+        now = monotonic()
+        for key, usage in rows:
+            bucket = _BUCKETS.get(key)
+            if bucket is not None:
+                bucket.usage = usage + bucket.pending
+                bucket.updated_at = now
+
+    _evict_empty()
+
+
+@cython.cfunc
+def _evict_empty():
+    """Forget buckets that fully leaked, they are reloaded on the next use."""
+    now = monotonic()
+    for key, bucket in tuple(_BUCKETS.items()):
+        if not bucket.pending and not bucket.leak(now):
+            del _BUCKETS[key]
+
+
 async def _delete_expired(conn: AsyncConnection):
     rowcount = await db_delete(
         'rate_limit',
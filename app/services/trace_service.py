@@ -9,8 +9,8 @@ from app.exceptions.context import raise_for
 from app.format.gpx import FormatGPX
 from app.lib.audit import audit
 from app.lib.auth.context import auth_user
+from app.lib.geo.trace_preview import trace_preview_lines
 from app.lib.io.trace_file import TraceFile
-from app.lib.io.xml_codec import XMLToDict
 from app.lib.storage import TRACE_STORAGE
 from app.lib.time.date_utils import utcnow
 from app.models.db.trace import (
@@ -23,6 +23,7 @@ from app.models.db.trace import (
 from app.models.proto.trace_types import Visibility
 from app.models.types import StorageKey, TraceId
 from app.queries.trace_query import TraceQuery
+from speedup import gpx_decode
 
 
 class TraceService:
@@ -50,19 +51,17 @@ class TraceService:
             file = await file.read()
 
         try:
-            tracks: list[dict] = []
-            for gpx_bytes in TraceFile.extract(file):
-                new_tracks = XMLToDict.parse(gpx_bytes).get('gpx', {}).get('trk', [])
-                tracks.extend(new_tracks)
+            gpx_files = await TraceFile.extract_decode(file, gpx_decode)
         except Exception as e:
             raise_for.bad_trace_file(str(e))
 
-        decoded = FormatGPX.decode_tracks(tracks)
+        decoded = FormatGPX.decode_tracks(gpx_files)
         logging.debug(
             'Organized %d points into %d segments',
             decoded.size,
             len(decoded.segments.geoms),
         )
+        preview_line, overview_line = trace_preview_lines(decoded.segments)
 
         trace_init: TraceInit = {
             'user_id': auth_user(required=True)['id'],
@@ -75,6 +74,8 @@ class TraceService:
             'segments': decoded.segments,
             'elevations': decoded.elevations,
             'capture_times': decoded.capture_times,
+            'preview_line': preview_line,
+            'overview_line': overview_line,
         }
         trace_init = TraceInitValidator.validate_python(trace_init)
 
@@ -94,6 +95,9 @@ class TraceService:
                     {
                         **trace_init,
                         'segments': t'ST_QuantizeCoordinates({segments}, 7)',
+                        'h3_cells': t"""h3_points_to_cells_range(
+                            ST_QuantizeCoordinates({segments}, 7), 11
+                        )""",
                     },
                     returning='id',
                     conn=conn,
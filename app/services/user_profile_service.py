@@ -46,6 +46,7 @@ class UserProfileService:
             {'avatar_type': avatar_type, 'avatar_id': avatar_id},
             where={'id': user_id},
         )
+        UserQuery.invalidate_user_display(user_id)
 
         # Cleanup old avatar
         if old_avatar_id is not None:
@@ -156,6 +157,9 @@ class UserProfileService:
             if display_name != user['display_name']:
                 await audit('change_display_name', conn, extra={'name': display_name})
 
+        if display_name != user['display_name']:
+            UserQuery.invalidate_user_display(user_id)
+
     @staticmethod
     async def update_email(
         *,
@@ -0,0 +1,350 @@
+import json
+import logging
+import platform
+import statistics
+import subprocess
+import sys
+from argparse import ArgumentParser
+from collections.abc import Callable
+from datetime import UTC, datetime, timedelta
+from pathlib import Path
+from random import Random
+from timeit import Timer
+from typing import Any, NamedTuple
+
+import numpy as np
+from shapely import Point, get_coordinates, points
+
+import app.format.api06_element
+from app.format import Format06
+from app.lib.geo.changeset_bounds import extend_changeset_bounds
+from app.lib.geo.compressible_geometry import compressible_geometry
+from app.lib.io.xml_codec import XMLToDict
+from app.lib.render import format_style
+from app.models.db.element import Element
+from app.models.element import ElementId
+from app.models.types import ChangesetId, SequenceId
+from speedup import (
+    buffered_rand_storage_key,
+    buffered_rand_urlsafe,
+    buffered_randbytes,
+    split_typed_element_ids,
+    typed_element_id,
+    xml_parse,
+    xml_unparse,
+)
+
+# Fixture sizes, in elements: a typical changeset upload and a full map response
+_SIZES = {'small': 1_000, 'large': 50_000}
+_SEED = 42
+_TAG_KEYS = (
+    'highway',
+    'building',
+    'name',
+    'name:en',
+    'addr:street',
+    'addr:housenumber',
+    'surface',
+    'source',
+    'natural',
+    'amenity',
+)
+_TAG_VALUES = ('yes', 'residential', 'asphalt', 'Main Street', '12a', 'bing', '道路')
+_ROLES = ('', 'outer', 'inner', 'stop', 'platform')
+
+
+class _Fixture(NamedTuple):
+    elements: list[Element]
+    typed_ids: list[int]
+    points: list[Point]
+    coords: np.ndarray
+    osm_xml: bytes
+    osm_dict: dict[str, Any]
+    osmchange_xml: bytes
+
+
+class _Benchmark(NamedTuple):
+    name: str
+    items: int
+    func: Callable[[], Any]
+
+
+def _make_elements(size: int) -> list[Element]:
+    """Generate elements with a planet-like mix: 80% nodes, 18% ways, 2% relations."""
+    rng = Random(_SEED)
+    created_at = datetime(2024, 1, 1, tzinfo=UTC)
+    num_nodes = size * 80 // 100
+    num_ways = size * 18 // 100
+    num_relations = size - num_nodes - num_ways
+    node_ids = [typed_element_id('node', ElementId(i)) for i in range(1, num_nodes + 1)]
+    way_ids = [typed_element_id('way', ElementId(i)) for i in range(1, num_ways + 1)]
+
+    def tags(max_tags: int):
+        return {
+            rng.choice(_TAG_KEYS): rng.choice(_TAG_VALUES)
+            for _ in range(rng.randint(0, max_tags))
+        } or None
+
+    def element(typed_id: int, i: int, **kwargs) -> Element:
+        return {
+            'sequence_id': SequenceId(i + 1),
+            'changeset_id': ChangesetId(rng.randint(1, 1_000_000)),
+            'typed_id': typed_id,  # type: ignore
+            'version': rng.randint(2, 10),
+            'visible': True,
+            'tags': None,
+            'point': None,
+            'members': None,
+            'members_roles': None,
+            'latest': True,
+            'created_at': created_at + timedelta(seconds=i),
+            **kwargs,
+        }
+
+    result: list[Element] = [
+        element(
+            typed_id,
+            i,
+            tags=tags(3) if rng.random() < 0.2 else None,
+            point=Point(
+                round(rng.uniform(-180, 180), 7),
+                round(rng.uniform(-90, 90), 7),
+            ),
+        )
+        for i, typed_id in enumerate(node_ids)
+    ]
+    result.extend(
+        element(
+            typed_id,
+            num_nodes + i,
+            tags=tags(6),
+            members=rng.choices(node_ids, k=rng.randint(2, 20)),
+        )
+        for i, typed_id in enumerate(way_ids)
+    )
+    for i in range(num_relations):
+        members = rng.choices(node_ids + way_ids, k=rng.randint(2, 30))
+        result.append(
+            element(
+                typed_element_id('relation', ElementId(i + 1)),
+                num_nodes + num_ways + i,
+                tags={'type': 'multipolygon', **(tags(4) or {})},
+                members=members,
+                members_roles=[rng.choice(_ROLES) for _ in members],
+            )
+        )
+    return result
+
+
+def _make_fixture(size: int) -> _Fixture:
+    elements = _make_elements(size)
+    element_points = [
+        point  #
+        for element in elements
+        if (point := element['point']) is not None
+    ]
+    osm_xml = Format06.encode_elements_xml(
+        elements,
+        head=b"<?xml version='1.0' encoding='UTF-8'?>\n<osm>",
+        tail=b'</osm>\n',
+    )
+    osmchange_xml = Format06.encode_elements_xml(
+        elements,
+        osmchange=True,
+        head=b"<?xml version='1.0' encoding='UTF-8'?>\n<osmChange>",
+        tail=b'</osmChange>\n',
+    )
+    return _Fixture(
+        elements=elements,
+        typed_ids=[element['typed_id'] for element in elements],
+        points=element_points,
+        coords=get_coordinates(element_points),
+        osm_xml=osm_xml,
+        osm_dict={'osm': Format06.encode_elements(elements)},
+        osmchange_xml=osmchange_xml,
+    )
+
+
+def _benchmarks(f: _Fixture) -> list[_Benchmark]:
+    n = len(f.elements)
+    split_pairs = split_typed_element_ids(f.typed_ids)
+    # Changeset uploads are limited to 10k elements
+    change_points = points(f.coords[:10_000]).tolist()
+
+    def typed_element_id_loop():
+        for type, id in split_pairs:
+            typed_element_id(type, id)
+
+    def randbytes_loop():
+        for _ in range(1_000):
+            buffered_randbytes(32)
+
+    def rand_urlsafe_loop():
+        for _ in range(1_000):
+            buffered_rand_urlsafe(32)
+
+    def rand_storage_key_loop():
+        for _ in range(1_000):
+            buffered_rand_storage_key('.webp')
+
+    return [
+        _Benchmark('xml_parse', n, lambda: xml_parse(f.osm_xml)),
+        _Benchmark('xml_unparse', n, lambda: xml_unparse(f.osm_dict, True)),
+        _Benchmark('typed_element_id', n, typed_element_id_loop),
+        _Benchmark(
+            'split_typed_element_ids', n, lambda: split_typed_element_ids(f.typed_ids)
+        ),
+        _Benchmark('buffered_randbytes', 1_000, randbytes_loop),
+        _Benchmark('buffered_rand_urlsafe', 1_000, rand_urlsafe_loop),
+        _Benchmark('buffered_rand_storage_key', 1_000, rand_storage_key_loop),
+        _Benchmark(
+            'Format06.encode_elements', n, lambda: Format06.encode_elements(f.elements)
+        ),
+        _Benchmark(
+            'Format06.encode_elements_xml',
+            n,
+            lambda: Format06.encode_elements_xml(f.elements),
+        ),
+        _Benchmark(
+            'Format06.decode_osmchange',
+            n,
+            lambda: Format06.decode_osmchange(
+                None, XMLToDict.parse(f.osmchange_xml)['osmChange']
+            ),
+        ),
+        _Benchmark(
+            'Format06.decode_osmchange_xml',
+            n,
+            lambda: Format06.decode_osmchange_xml(None, f.osmchange_xml),
+        ),
+        _Benchmark(
+            'extend_changeset_bounds',
+            len(change_points),
+            lambda: extend_changeset_bounds(None, change_points),
+        ),
+        _Benchmark(
+            'compressible_geometry[array]',
+            len(f.coords),
+            lambda: compressible_geometry(f.coords),
+        ),
+        _Benchmark(
+            'compressible_geometry[point]',
+            1_000,
+            lambda: [compressible_geometry(p) for p in f.points[:1_000]],
+        ),
+    ]
+
+
+def _measure(benchmark: _Benchmark, repeat: int) -> dict[str, Any]:
+    timer = Timer(benchmark.func)
+    loops, _ = timer.autorange()
+    samples = [t / loops * 1e9 for t in timer.repeat(repeat, loops)]
+    median = statistics.median(samples)
+    return {
+        'loops': loops,
+        'repeat': repeat,
+        'min_ns': round(min(samples)),
+        'median_ns': round(median),
+        'stdev_ns': round(statistics.stdev(samples)) if repeat > 1 else 0,
+        'items_per_s': round(benchmark.items / median * 1e9),
+    }
+
+
+def _metadata() -> dict[str, Any]:
+    commit = subprocess.run(
+        ('git', 'rev-parse', 'HEAD'),
+        capture_output=True,
+        text=True,
+        check=False,
+    ).stdout.strip()
+    return {
+        'commit': commit or None,
+        'timestamp': datetime.now(UTC).isoformat(),
+        'python': platform.python_version(),
+        'machine': platform.machine(),
+        'cython_compiled': Path(app.format.api06_element.__file__).suffix != '.py',
+    }
+
+
+def _compare(baseline_path: Path, results: list[dict[str, Any]]):
+    baseline = {
+        (r['name'], r['size']): r
+        for r in json.loads(baseline_path.read_bytes())['results']
+    }
+    for result in results:
+        base = baseline.get((result['name'], result['size']))
+        if base is None:
+            continue
+        change = result['median_ns'] / base['median_ns'] - 1
+        logging.info(
+            '%-32s %-6s %+7.1f%% (%d → %d ns)',
+            result['name'],
+            result['size'],
+            change * 100,
+            base['median_ns'],
+            result['median_ns'],
+        )
+
+
+def main():
+    parser = ArgumentParser(
+        description='Benchmark speedup and Cython-compiled hot paths',
+        suggest_on_error=True,
+    )
+    parser.add_argument(
+        '--size',
+        choices=tuple(_SIZES),
+        action='append',
+        help='Fixture size to run (default: all)',
+    )
+    parser.add_argument(
+        '-k',
+        '--filter',
+        help='Only run benchmarks whose name contains this substring',
+    )
+    parser.add_argument(
+        '--repeat',
+        type=int,
+        default=7,
+        help='Number of timed repetitions per benchmark',
+    )
+    parser.add_argument(
+        '-o',
+        '--output',
+        type=Path,
+        help='Write JSON results to this file instead of stdout',
+    )
+    parser.add_argument(
+        '--compare',
+        type=Path,
+        help='Log median changes against a previous JSON results file',
+    )
+    args = parser.parse_args()
+
+    results: list[dict[str, Any]] = []
+    with format_style._CTX.set('xml'):  # noqa: SLF001
+        for size_name in args.size or _SIZES:
+            fixture = _make_fixture(_SIZES[size_name])
+            for benchmark in _benchmarks(fixture):
+                if args.filter and args.filter not in benchmark.name:
+                    continue
+                logging.debug('Running %s (%s)', benchmark.name, size_name)
+                results.append({
+                    'name': benchmark.name,
+                    'size': size_name,
+                    'items': benchmark.items,
+                    **_measure(benchmark, args.repeat),
+                })
+
+    data = json.dumps({'meta': _metadata(), 'results': results}, indent=2)
+    if args.output is not None:
+        args.output.write_text(data + '\n')
+    else:
+        sys.stdout.write(data + '\n')
+
+    if args.compare is not None:
+        _compare(args.compare, results)
+
+
+if __name__ == '__main__':
+    main()
@@ -23,7 +23,6 @@ from app.models.element import (
     TYPED_ELEMENT_ID_RELATION_MIN,
     TypedElementId,
 )
-from app.models.proto.shared_types import ElementType
 from app.utils import calc_num_workers
 from speedup import typed_element_id
 
@@ -86,6 +85,7 @@ _NOTES_SCHEMA = pa.schema([
 
 _NUM_WORKERS = calc_num_workers()
 _TASK_SIZE = 64 * 1024 * 1024  # 64 MB
+_READ_CHUNK_SIZE = 1024 * 1024  # 1 MB
 
 
 @cython.cfunc
@@ -98,28 +98,37 @@ def _get_worker_path(base: Path, i: cython.size_t):
     return base.with_suffix(f'{base.suffix}.{i}')
 
 
-def planet_worker(args: tuple[int, int, int, int]):
+def _read_worker_chunks(path: Path, root: bytes, args: tuple[int, int, int, int]):
+    """Read the task byte range, wrapped in the root element if cut mid-document."""
     i, num_tasks, from_seek, to_seek = args  # from_seek(inclusive), to_seek(exclusive)
-    data: list[dict] = []
 
-    with PLANET_INPUT_PATH.open('rb') as f_in:
-        parts: list[bytes] = []
-        if from_seek > 0:
-            parts.append(b'<osm>')
-            f_in.seek(from_seek)
-        parts.append(f_in.read(to_seek - from_seek))
-        if i + 1 < num_tasks:
-            parts.append(b'</osm>')
-        input_buffer = b''.join(parts)
+    if from_seek > 0:
+        yield b'<' + root + b'>'
+
+    with path.open('rb') as f_in:
+        f_in.seek(from_seek)
+        remaining = to_seek - from_seek
+        while remaining > 0:
+            chunk = f_in.read(min(remaining, _READ_CHUNK_SIZE))
+            if not chunk:
+                break
+            remaining -= len(chunk)
+            yield chunk
+
+    if i + 1 < num_tasks:
+        yield b'</' + root + b'>'
 
-    elements: list[tuple[ElementType, dict]]
-    elements = XMLToDict.parse(input_buffer, size_limit=None)['osm']
-    del input_buffer, parts  # free memory
+
+def planet_worker(args: tuple[int, int, int, int]):
+    i = args[0]
+    data: list[dict] = []
 
     type: str
     element: dict
 
-    for type, element in elements:
+    for type, element in XMLToDict.parse_iter(
+        _read_worker_chunks(PLANET_INPUT_PATH, b'osm', args)
+    ):
         tags = (
             {tag['@k']: tag['@v'] for tag in tags_}
             if (tags_ := element.get('tag')) is not None
@@ -238,26 +247,15 @@ def merge_planet_worker_results():
 
 
 def changesets_worker(args: tuple[int, int, int, int]):
-    i, num_tasks, from_seek, to_seek = args  # from_seek(inclusive), to_seek(exclusive)
+    i = args[0]
     data: list[dict] = []
 
-    with CHANGESETS_INPUT_PATH.open('rb') as f_in:
-        parts: list[bytes] = []
-        if from_seek > 0:
-            parts.append(b'<osm>')
-            f_in.seek(from_seek)
-        parts.append(f_in.read(to_seek - from_seek))
-        if i + 1 < num_tasks:
-            parts.append(b'</osm>')
-        input_buffer = b''.join(parts)
-
-    changesets: list[dict]
-    changesets = XMLToDict.parse(input_buffer, size_limit=None)['osm']['changeset']
-    del input_buffer, parts  # free memory
-
+    name: str
     changeset: dict
-    for changeset in changesets:
-        if '@min_lon' not in changeset:
+    for name, changeset in XMLToDict.parse_iter(
+        _read_worker_chunks(CHANGESETS_INPUT_PATH, b'osm', args)
+    ):
+        if name != 'changeset' or '@min_lon' not in changeset:
             continue
 
         tags = (
@@ -346,25 +344,17 @@ def merge_changesets_worker_results():
 
 
 def notes_worker(args: tuple[int, int, int, int]):
-    i, num_tasks, from_seek, to_seek = args  # from_seek(inclusive), to_seek(exclusive)
+    i = args[0]
     data: list[dict] = []
 
-    with NOTES_INPUT_PATH.open('rb') as f_in:
-        parts: list[bytes] = []
-        if from_seek > 0:
-            parts.append(b'<osm-notes>')
-            f_in.seek(from_seek)
-        parts.append(f_in.read(to_seek - from_seek))
-        if i + 1 < num_tasks:
-            parts.append(b'</osm-notes>')
-        input_buffer = b''.join(parts)
-
-    notes: list[dict]
-    notes = XMLToDict.parse(input_buffer, size_limit=None)['osm-notes']['note']
-    del input_buffer, parts  # free memory
-
+    name: str
     note: dict
-    for note in notes:
+    for name, note in XMLToDict.parse_iter(
+        _read_worker_chunks(NOTES_INPUT_PATH, b'osm-notes', args)
+    ):
+        if name != 'note':
+            continue
+
         # Skip notes without comments
         note_comments: list[dict] | None = note.get('comment')
         if note_comments is None:
@@ -20,7 +20,6 @@ from app.config import (
 )
 from app.db import db
 from app.format import Format06
-from app.lib.io.xml_codec import XMLToDict
 from app.lib.time.date_utils import utcnow
 from app.models.db.element import Element
 from app.utils import calc_num_workers
@@ -330,19 +329,16 @@ async def _generate_diff(timespan: _TimeSpan, state: _State, next_timestamp: dat
         logging.debug('Started pigz compression process')
 
         async for chunk in _fetch_changes(state['timestamp'], next_timestamp):
-            content: bytes = XMLToDict.unparse(
-                {'osmChange': Format06.encode_osmchange(chunk)}, binary=True
+            content = Format06.encode_elements_xml(
+                chunk,
+                osmchange=True,
+                head=(
+                    b"<?xml version='1.0' encoding='UTF-8'?>\n<osmChange>"
+                    if not has_data
+                    else b''
+                ),
             )
 
-            # Extract osmChange content (avoid duplication)
-            slice_start: cython.size_t = (
-                0
-                if not has_data
-                else content.index(b'>', content.index(b'<osmChange')) + 1
-            )
-            slice_end: cython.size_t = content.rindex(b'</osmChange>')
-            content = content[slice_start:slice_end]
-
             pigz_stdin.write(content)
             del content
             await pigz_stdin.drain()
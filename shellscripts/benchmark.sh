@@ -0,0 +1 @@
+python scripts/benchmark.py "$@"
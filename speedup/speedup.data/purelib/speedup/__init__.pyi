@@ -2,17 +2,31 @@ from typing import Any, Literal, LiteralString, overload
 
 from app.models.db.element import Element, ElementInit
 from app.models.element import ElementId, ElementType, TypedElementId
-from app.models.types import StorageKey
+from app.models.types import ChangesetId, StorageKey
 
 class CDATA:
     def __init__(self, text: str, /) -> None: ...
 
+class ElementCopyWriter:
+    def __init__(self) -> None: ...
+    def write_elements(self, elements: list[Element], coords: bytes, /) -> None: ...
+    def finish(self) -> None: ...
+    def take(self) -> bytes: ...
+
+class ElementXMLWriter:
+    def __init__(self, high_precision_time: bool = False) -> None: ...
+    def write(self, data: bytes, /) -> None: ...
+    def write_elements(self, elements: list[Element], coords: bytes, /) -> None: ...
+    def write_osmchange(self, elements: list[Element], coords: bytes, /) -> None: ...
+    def take(self) -> bytes: ...
+
 def buffered_randbytes(n: int, /) -> bytes: ...
 def buffered_rand_urlsafe(n: int, /) -> str: ...
 def buffered_rand_storage_key(suffix: LiteralString = '') -> StorageKey: ...
 def element_id(typed_id: TypedElementId, /) -> ElementId: ...
 def element_type(typed_id: TypedElementId, /) -> ElementType: ...
 def typed_element_id(type: ElementType, id: ElementId, /) -> TypedElementId: ...
+def gpx_decode(xml: bytes, /) -> tuple[bytes, bytes, bytes, bytes]: ...
 def versioned_typed_element_id(
     type: ElementType, s: str, /
 ) -> tuple[TypedElementId, int]: ...
@@ -23,6 +37,19 @@ def split_typed_element_ids(
 def xattr_json(name: str, /, xml=None) -> str: ...
 def xattr_xml(name: str, /, xml: LiteralString | None = None) -> str: ...
 def xml_parse(xml: bytes, /) -> dict[str, Any]: ...
+
+class OSMChangeDecoder:
+    def __init__(self, changeset_id: ChangesetId | None, /) -> None: ...
+    def feed(self, chunk: bytes, /) -> tuple[list[ElementInit], bytes, bytes]: ...
+    def close(self) -> tuple[list[ElementInit], bytes, bytes]: ...
+
+class XMLStreamParser:
+    def __init__(self) -> None: ...
+    def feed(self, chunk: bytes, /) -> list[tuple[str, Any]]: ...
+    def close(self) -> list[tuple[str, Any]]: ...
+    @property
+    def root(self) -> str | None: ...
+
 @overload
 def xml_unparse(root: dict[str, Any], binary: Literal[True], /) -> bytes: ...
 @overload
@@ -0,0 +1,214 @@
+use std::hint::unlikely;
+
+use pyo3::exceptions::PyValueError;
+use pyo3::intern;
+use pyo3::prelude::*;
+use pyo3::types::{PyBytes, PyDict, PyList, PyString};
+
+use crate::element_xml::{get_field, read_coords};
+
+// PostgreSQL binary COPY format, see: https://www.postgresql.org/docs/current/sql-copy.html
+const COPY_SIGNATURE: &[u8] = b"PGCOPY\n\xff\r\n\0";
+const COPY_TRAILER: i16 = -1;
+const ELEMENT_COLUMNS: i16 = 10;
+
+const INT8_OID: u32 = 20;
+const TEXT_OID: u32 = 25;
+
+const EWKB_POINT_WITH_SRID: u32 = 0x2000_0001;
+const SRID: u32 = 4326;
+
+/// Reserve a field length prefix, write the field, then backfill the length.
+fn write_field(buf: &mut Vec<u8>, f: impl FnOnce(&mut Vec<u8>) -> PyResult<()>) -> PyResult<()> {
+    let start = buf.len();
+    buf.extend_from_slice(&0_i32.to_be_bytes());
+    f(buf)?;
+    let len = i32::try_from(buf.len() - start - 4)
+        .map_err(|_| PyValueError::new_err("COPY field is too large"))?;
+    buf[start..start + 4].copy_from_slice(&len.to_be_bytes());
+    Ok(())
+}
+
+fn write_null(buf: &mut Vec<u8>) {
+    buf.extend_from_slice(&(-1_i32).to_be_bytes());
+}
+
+fn write_int8(buf: &mut Vec<u8>, value: i64) {
+    buf.extend_from_slice(&8_i32.to_be_bytes());
+    buf.extend_from_slice(&value.to_be_bytes());
+}
+
+fn write_bool(buf: &mut Vec<u8>, value: bool) {
+    buf.extend_from_slice(&1_i32.to_be_bytes());
+    buf.push(value as u8);
+}
+
+fn write_text(buf: &mut Vec<u8>, value: &str) -> PyResult<()> {
+    let len = i32::try_from(value.len())
+        .map_err(|_| PyValueError::new_err("COPY text value is too large"))?;
+    buf.extend_from_slice(&len.to_be_bytes());
+    buf.extend_from_slice(value.as_bytes());
+    Ok(())
+}
+
+/// Write a one-dimensional array header, without NULL elements.
+fn write_array_header(buf: &mut Vec<u8>, elem_oid: u32, len: usize) -> PyResult<()> {
+    if len == 0 {
+        buf.extend_from_slice(&0_i32.to_be_bytes()); // ndim
+        buf.extend_from_slice(&0_i32.to_be_bytes()); // has nulls
+        buf.extend_from_slice(&elem_oid.to_be_bytes());
+        return Ok(());
+    }
+    let len = i32::try_from(len).map_err(|_| PyValueError::new_err("COPY array is too large"))?;
+    buf.extend_from_slice(&1_i32.to_be_bytes()); // ndim
+    buf.extend_from_slice(&0_i32.to_be_bytes()); // has nulls
+    buf.extend_from_slice(&elem_oid.to_be_bytes());
+    buf.extend_from_slice(&len.to_be_bytes());
+    buf.extend_from_slice(&1_i32.to_be_bytes()); // lower bound
+    Ok(())
+}
+
+fn write_tags(buf: &mut Vec<u8>, tags: &Bound<'_, PyAny>) -> PyResult<()> {
+    let Ok(tags) = tags.cast::<PyDict>() else {
+        write_null(buf);
+        return Ok(());
+    };
+    write_field(buf, |buf| {
+        // hstore_send: pair count, then (key, value) text pairs
+        let len = i32::try_from(tags.len())
+            .map_err(|_| PyValueError::new_err("Too many element tags"))?;
+        buf.extend_from_slice(&len.to_be_bytes());
+        tags.iter().try_for_each(|(k, v)| -> PyResult<()> {
+            write_text(buf, k.cast::<PyString>()?.to_str()?)?;
+            write_text(buf, v.cast::<PyString>()?.to_str()?)
+        })
+    })
+}
+
+fn write_point(buf: &mut Vec<u8>, point: Option<(f64, f64)>) {
+    let Some((lon, lat)) = point else {
+        write_null(buf);
+        return;
+    };
+    // geometry_recv accepts EWKB
+    buf.extend_from_slice(&25_i32.to_be_bytes());
+    buf.push(1); // little endian
+    buf.extend_from_slice(&EWKB_POINT_WITH_SRID.to_le_bytes());
+    buf.extend_from_slice(&SRID.to_le_bytes());
+    buf.extend_from_slice(&lon.to_le_bytes());
+    buf.extend_from_slice(&lat.to_le_bytes());
+}
+
+fn write_members(buf: &mut Vec<u8>, members: &Bound<'_, PyAny>) -> PyResult<()> {
+    let Ok(members) = members.cast::<PyList>() else {
+        write_null(buf);
+        return Ok(());
+    };
+    write_field(buf, |buf| {
+        write_array_header(buf, INT8_OID, members.len())?;
+        buf.reserve(members.len() * 12);
+        members.iter().try_for_each(|member| -> PyResult<()> {
+            write_int8(buf, member.extract()?);
+            Ok(())
+        })
+    })
+}
+
+fn write_roles(buf: &mut Vec<u8>, roles: &Bound<'_, PyAny>) -> PyResult<()> {
+    let Ok(roles) = roles.cast::<PyList>() else {
+        write_null(buf);
+        return Ok(());
+    };
+    write_field(buf, |buf| {
+        write_array_header(buf, TEXT_OID, roles.len())?;
+        roles
+            .iter()
+            .try_for_each(|role| write_text(buf, role.cast::<PyString>()?.to_str()?))
+    })
+}
+
+#[pyclass]
+struct ElementCopyWriter {
+    buf: Vec<u8>,
+}
+
+#[pymethods]
+impl ElementCopyWriter {
+    /// Start a binary COPY stream for the element table, with the header already buffered.
+    #[new]
+    fn new() -> Self {
+        let mut buf = Vec::new();
+        buf.extend_from_slice(COPY_SIGNATURE);
+        buf.extend_from_slice(&0_i32.to_be_bytes()); // flags
+        buf.extend_from_slice(&0_i32.to_be_bytes()); // header extension length
+        Self { buf }
+    }
+
+    /// Append element rows in the column order: sequence_id, changeset_id, typed_id, version,
+    /// latest, visible, tags, point, members, members_roles.
+    /// `coords` holds packed native-endian f64 (lon, lat) pairs, one per non-null point.
+    #[pyo3(signature = (elements, coords, /))]
+    fn write_elements(
+        &mut self,
+        py: Python<'_>,
+        elements: &Bound<'_, PyList>,
+        coords: &[u8],
+    ) -> PyResult<()> {
+        let buf = &mut self.buf;
+        let mut coords_index = 0;
+        for element in elements.iter() {
+            let element = element.cast_into::<PyDict>()?;
+            buf.extend_from_slice(&ELEMENT_COLUMNS.to_be_bytes());
+
+            for key in [
+                intern!(py, "sequence_id"),
+                intern!(py, "changeset_id"),
+                intern!(py, "typed_id"),
+                intern!(py, "version"),
+            ] {
+                write_int8(buf, get_field(&element, key)?.extract()?);
+            }
+            write_bool(buf, get_field(&element, intern!(py, "latest"))?.extract()?);
+            write_bool(buf, get_field(&element, intern!(py, "visible"))?.extract()?);
+            write_tags(buf, &get_field(&element, intern!(py, "tags"))?)?;
+
+            let point = if get_field(&element, intern!(py, "point"))?.is_none() {
+                None
+            } else {
+                coords_index += 1;
+                Some(read_coords(coords, coords_index - 1)?)
+            };
+            write_point(buf, point);
+
+            let members = get_field(&element, intern!(py, "members"))?;
+            let roles = get_field(&element, intern!(py, "members_roles"))?;
+            if let (Ok(members), Ok(roles)) = (members.cast::<PyList>(), roles.cast::<PyList>())
+                && unlikely(members.len() != roles.len())
+            {
+                return Err(PyValueError::new_err(
+                    "members and members_roles must be equal length",
+                ));
+            }
+            write_members(buf, &members)?;
+            write_roles(buf, &roles)?;
+        }
+        Ok(())
+    }
+
+    /// Append the end-of-data trailer. No rows may be written afterwards.
+    fn finish(&mut self) {
+        self.buf.extend_from_slice(&COPY_TRAILER.to_be_bytes());
+    }
+
+    /// Return the buffered bytes and reset the buffer, keeping its capacity for reuse.
+    fn take(&mut self, py: Python<'_>) -> Py<PyBytes> {
+        let out = PyBytes::new(py, &self.buf).unbind();
+        self.buf.clear();
+        out
+    }
+}
+
+pub(crate) fn register(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_class::<ElementCopyWriter>()?;
+    Ok(())
+}
@@ -5,9 +5,9 @@ use pyo3::prelude::*;
 use pyo3::sync::PyOnceLock;
 use pyo3::types::{PyDict, PyList, PyString, PyTuple};
 
-const NODE_TYPE_NUM: u64 = 0;
-const WAY_TYPE_NUM: u64 = 1;
-const RELATION_TYPE_NUM: u64 = 2;
+pub(crate) const NODE_TYPE_NUM: u64 = 0;
+pub(crate) const WAY_TYPE_NUM: u64 = 1;
+pub(crate) const RELATION_TYPE_NUM: u64 = 2;
 
 const TYPE_SHIFT: u8 = 60;
 const TYPE_MASK: u64 = 0b11;
@@ -18,11 +18,11 @@ static NODE_STR: PyOnceLock<Py<PyString>> = PyOnceLock::new();
 static WAY_STR: PyOnceLock<Py<PyString>> = PyOnceLock::new();
 static RELATION_STR: PyOnceLock<Py<PyString>> = PyOnceLock::new();
 
-fn type_num_from_typed_id(typed_id: u64) -> u64 {
+pub(crate) fn type_num_from_typed_id(typed_id: u64) -> u64 {
     (typed_id >> TYPE_SHIFT) & TYPE_MASK
 }
 
-fn element_id_from_typed_id(typed_id: u64) -> i64 {
+pub(crate) fn element_id_from_typed_id(typed_id: u64) -> i64 {
     let mut element_id = (typed_id & ID_MASK) as i64;
     if (typed_id & SIGN_MASK) != 0 {
         element_id = -element_id;
@@ -42,7 +42,7 @@ fn type_str_from_num(py: Python<'_>, type_num: u64) -> PyResult<Py<PyString>> {
     Ok(out.clone_ref(py))
 }
 
-fn type_num_from_str(type_: &str) -> PyResult<u64> {
+pub(crate) fn type_num_from_str(type_: &str) -> PyResult<u64> {
     match type_ {
         "node" => Ok(NODE_TYPE_NUM),
         "way" => Ok(WAY_TYPE_NUM),
@@ -55,7 +55,7 @@ fn type_num_from_str(type_: &str) -> PyResult<u64> {
     }
 }
 
-fn typed_element_id_impl(type_num: u64, id: i64) -> PyResult<u64> {
+pub(crate) fn typed_element_id_impl(type_num: u64, id: i64) -> PyResult<u64> {
     let abs = id.unsigned_abs();
     if unlikely(abs > ID_MASK) {
         let msg = if id < 0 {
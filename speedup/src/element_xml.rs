@@ -0,0 +1,325 @@
+use std::hint::unlikely;
+use std::io::Write;
+
+use pyo3::exceptions::PyValueError;
+use pyo3::intern;
+use pyo3::prelude::*;
+use pyo3::types::{PyBytes, PyDateAccess, PyDateTime, PyDict, PyList, PyString, PyTimeAccess};
+
+use crate::element_type::{
+    NODE_TYPE_NUM, RELATION_TYPE_NUM, WAY_TYPE_NUM, element_id_from_typed_id,
+    type_num_from_typed_id,
+};
+use crate::xml_unparse::escape_attr;
+
+/// Buffer capacity kept after `take`, so one huge document doesn't pin its peak memory.
+const MAX_RETAINED_CAPACITY: usize = 4 * 1024 * 1024;
+
+fn type_name(type_num: u64) -> &'static str {
+    match type_num {
+        NODE_TYPE_NUM => "node",
+        WAY_TYPE_NUM => "way",
+        _ => "relation",
+    }
+}
+
+fn write_attr_str(buf: &mut Vec<u8>, name: &str, value: &str) {
+    buf.push(b' ');
+    buf.extend_from_slice(name.as_bytes());
+    buf.extend_from_slice(b"=\"");
+    buf.extend_from_slice(escape_attr(value).as_bytes());
+    buf.push(b'"');
+}
+
+fn write_coord(buf: &mut Vec<u8>, name: &str, value: f64) {
+    // Match Python float str(): integral values keep a trailing ".0".
+    if value.fract() == 0.0 && value.abs() < 1e16 {
+        write!(buf, " {name}=\"{value:.1}\"").unwrap();
+    } else {
+        write!(buf, " {name}=\"{value}\"").unwrap();
+    }
+}
+
+fn write_timestamp(buf: &mut Vec<u8>, dt: &Bound<'_, PyDateTime>, high_precision: bool) {
+    write!(
+        buf,
+        " timestamp=\"{:04}-{:02}-{:02}T{:02}:{:02}:{:02}",
+        dt.get_year(),
+        dt.get_month(),
+        dt.get_day(),
+        dt.get_hour(),
+        dt.get_minute(),
+        dt.get_second(),
+    )
+    .unwrap();
+    let micro = dt.get_microsecond();
+    if high_precision && micro != 0 {
+        write!(buf, ".{micro:06}").unwrap();
+    }
+    buf.extend_from_slice(b"Z\"");
+}
+
+pub(crate) fn get_field<'py>(
+    element: &Bound<'py, PyDict>,
+    key: &Bound<'py, PyString>,
+) -> PyResult<Bound<'py, PyAny>> {
+    element
+        .get_item(key)?
+        .ok_or_else(|| PyValueError::new_err(format!("Element is missing {key} field")))
+}
+
+#[pyclass]
+struct ElementXMLWriter {
+    buf: Vec<u8>,
+    high_precision_time: bool,
+}
+
+impl ElementXMLWriter {
+    fn write_element(
+        &mut self,
+        py: Python<'_>,
+        element: &Bound<'_, PyDict>,
+        type_num: u64,
+        typed_id: u64,
+        point: Option<(f64, f64)>,
+    ) -> PyResult<()> {
+        let type_s = type_name(type_num);
+        let buf = &mut self.buf;
+
+        buf.push(b'<');
+        buf.extend_from_slice(type_s.as_bytes());
+        write!(
+            buf,
+            " id=\"{}\" version=\"{}\"",
+            element_id_from_typed_id(typed_id),
+            get_field(element, intern!(py, "version"))?.extract::<i64>()?
+        )
+        .unwrap();
+
+        if let Some(user) = element.get_item(intern!(py, "user"))? {
+            let user_id: i64 = get_field(element, intern!(py, "user_id"))?.extract()?;
+            let display_name = user.get_item(intern!(py, "display_name"))?;
+            write!(buf, " uid=\"{user_id}\"").unwrap();
+            write_attr_str(buf, "user", display_name.cast::<PyString>()?.to_str()?);
+        }
+
+        write!(
+            buf,
+            " changeset=\"{}\"",
+            get_field(element, intern!(py, "changeset_id"))?.extract::<i64>()?
+        )
+        .unwrap();
+        write_timestamp(
+            buf,
+            get_field(element, intern!(py, "created_at"))?.cast::<PyDateTime>()?,
+            self.high_precision_time,
+        );
+        let visible: bool = get_field(element, intern!(py, "visible"))?.extract()?;
+        buf.extend_from_slice(if visible {
+            b" visible=\"true\""
+        } else {
+            b" visible=\"false\""
+        });
+
+        if let Some((lon, lat)) = point {
+            write_coord(buf, "lon", lon);
+            write_coord(buf, "lat", lat);
+        }
+
+        let mut has_children = false;
+        let mut open_children = |buf: &mut Vec<u8>| {
+            if !has_children {
+                buf.push(b'>');
+                has_children = true;
+            }
+        };
+
+        let tags = get_field(element, intern!(py, "tags"))?;
+        if let Ok(tags) = tags.cast::<PyDict>() {
+            tags.iter().try_for_each(|(k, v)| -> PyResult<()> {
+                open_children(buf);
+                buf.extend_from_slice(b"<tag");
+                write_attr_str(buf, "k", k.cast::<PyString>()?.to_str()?);
+                write_attr_str(buf, "v", v.cast::<PyString>()?.to_str()?);
+                buf.extend_from_slice(b"/>");
+                Ok(())
+            })?;
+        }
+
+        if type_num != NODE_TYPE_NUM {
+            let members = get_field(element, intern!(py, "members"))?;
+            if let Ok(members) = members.cast::<PyList>() {
+                if type_num == WAY_TYPE_NUM {
+                    members.iter().try_for_each(|member| -> PyResult<()> {
+                        open_children(buf);
+                        let member_id = element_id_from_typed_id(member.extract()?);
+                        write!(buf, "<nd ref=\"{member_id}\"/>").unwrap();
+                        Ok(())
+                    })?;
+                } else if let Ok(roles) =
+                    get_field(element, intern!(py, "members_roles"))?.cast_into::<PyList>()
+                {
+                    if unlikely(roles.len() != members.len()) {
+                        return Err(PyValueError::new_err(
+                            "members and members_roles must be equal length",
+                        ));
+                    }
+                    members.iter().zip(roles.iter()).try_for_each(
+                        |(member, role)| -> PyResult<()> {
+                            open_children(buf);
+                            let member_typed_id: u64 = member.extract()?;
+                            write!(
+                                buf,
+                                "<member type=\"{}\" ref=\"{}\"",
+                                type_name(type_num_from_typed_id(member_typed_id)),
+                                element_id_from_typed_id(member_typed_id)
+                            )
+                            .unwrap();
+                            write_attr_str(buf, "role", role.cast::<PyString>()?.to_str()?);
+                            buf.extend_from_slice(b"/>");
+                            Ok(())
+                        },
+                    )?;
+                }
+            }
+        }
+
+        if has_children {
+            write!(buf, "</{type_s}>").unwrap();
+        } else {
+            buf.extend_from_slice(b"/>");
+        }
+        Ok(())
+    }
+}
+
+pub(crate) fn read_coords(coords: &[u8], index: usize) -> PyResult<(f64, f64)> {
+    let offset = index * 16;
+    let chunk = coords
+        .get(offset..offset + 16)
+        .ok_or_else(|| PyValueError::new_err("Not enough coordinates for element points"))?;
+    let lon = f64::from_ne_bytes(chunk[..8].try_into().unwrap());
+    let lat = f64::from_ne_bytes(chunk[8..].try_into().unwrap());
+    Ok((lon, lat))
+}
+
+#[pymethods]
+impl ElementXMLWriter {
+    #[new]
+    #[pyo3(signature = (high_precision_time = false))]
+    fn new(high_precision_time: bool) -> Self {
+        Self {
+            buf: Vec::new(),
+            high_precision_time,
+        }
+    }
+
+    /// Append raw bytes, e.g. a document header or footer.
+    fn write(&mut self, data: &[u8]) {
+        self.buf.extend_from_slice(data);
+    }
+
+    /// Append elements grouped by type (nodes, ways, relations), as in an `<osm>` document.
+    /// `coords` holds packed native-endian f64 (lon, lat) pairs, one per non-null point.
+    #[pyo3(signature = (elements, coords, /))]
+    fn write_elements(
+        &mut self,
+        py: Python<'_>,
+        elements: &Bound<'_, PyList>,
+        coords: &[u8],
+    ) -> PyResult<()> {
+        for pass_type_num in [NODE_TYPE_NUM, WAY_TYPE_NUM, RELATION_TYPE_NUM] {
+            let mut coords_index = 0;
+            for element in elements.iter() {
+                let element = element.cast_into::<PyDict>()?;
+                let typed_id: u64 = element
+                    .get_item(intern!(py, "typed_id"))?
+                    .ok_or_else(|| PyValueError::new_err("Element is missing typed_id"))?
+                    .extract()?;
+                let has_point = element
+                    .get_item(intern!(py, "point"))?
+                    .is_some_and(|point| !point.is_none());
+
+                if type_num_from_typed_id(typed_id) == pass_type_num {
+                    let point = if has_point {
+                        Some(read_coords(coords, coords_index)?)
+                    } else {
+                        None
+                    };
+                    self.write_element(py, &element, pass_type_num, typed_id, point)?;
+                }
+                if has_point {
+                    coords_index += 1;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Append elements as osmChange actions, each wrapped in its own create/modify/delete.
+    #[pyo3(signature = (elements, coords, /))]
+    fn write_osmchange(
+        &mut self,
+        py: Python<'_>,
+        elements: &Bound<'_, PyList>,
+        coords: &[u8],
+    ) -> PyResult<()> {
+        let mut coords_index = 0;
+        for element in elements.iter() {
+            let element = element.cast_into::<PyDict>()?;
+            let typed_id: u64 = element
+                .get_item(intern!(py, "typed_id"))?
+                .ok_or_else(|| PyValueError::new_err("Element is missing typed_id"))?
+                .extract()?;
+            let point = if element
+                .get_item(intern!(py, "point"))?
+                .is_some_and(|point| !point.is_none())
+            {
+                coords_index += 1;
+                Some(read_coords(coords, coords_index - 1)?)
+            } else {
+                None
+            };
+
+            // Determine the action automatically
+            let action = if element
+                .get_item(intern!(py, "version"))?
+                .is_some_and(|version| version.extract::<i64>().is_ok_and(|v| v == 1))
+            {
+                "create"
+            } else if element
+                .get_item(intern!(py, "visible"))?
+                .is_some_and(|visible| visible.is_truthy().unwrap_or(false))
+            {
+                "modify"
+            } else {
+                "delete"
+            };
+
+            write!(self.buf, "<{action}>").unwrap();
+            self.write_element(
+                py,
+                &element,
+                type_num_from_typed_id(typed_id),
+                typed_id,
+                point,
+            )?;
+            write!(self.buf, "</{action}>").unwrap();
+        }
+        Ok(())
+    }
+
+    /// Return the buffered bytes and reset the buffer.
+    /// Capacity is kept for reuse, up to MAX_RETAINED_CAPACITY.
+    fn take(&mut self, py: Python<'_>) -> Py<PyBytes> {
+        let out = PyBytes::new(py, &self.buf).unbind();
+        self.buf.clear();
+        self.buf.shrink_to(MAX_RETAINED_CAPACITY);
+        out
+    }
+}
+
+pub(crate) fn register(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_class::<ElementXMLWriter>()?;
+    Ok(())
+}
@@ -0,0 +1,328 @@
+use std::hint::unlikely;
+
+use pyo3::exceptions::PyValueError;
+use pyo3::prelude::*;
+use pyo3::types::{PyBytes, PyTuple};
+use quick_xml::Reader;
+use quick_xml::escape::unescape as xml_unescape;
+use quick_xml::events::{BytesStart, Event};
+
+use crate::osmchange_decode::{for_each_attr, parse_attr};
+
+/// Capture time of points without a `<time>` element.
+const NO_TIME: i64 = i64::MIN;
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Tag {
+    Gpx,
+    Trk,
+    Trkseg,
+    Trkpt,
+    Ele,
+    Time,
+    Other,
+}
+
+struct Decoder {
+    stack: Vec<Tag>,
+    has_root: bool,
+    coords: Vec<u8>,
+    segment_sizes: Vec<u8>,
+    elevations: Vec<u8>,
+    times: Vec<u8>,
+    segment_size: u64,
+    point: Option<(f64, f64)>,
+    elevation: f32,
+    time: i64,
+    text: String,
+}
+
+impl Decoder {
+    fn new(capacity: usize) -> Self {
+        // Rough estimate: a bare <trkpt> with <ele> and <time> is ~100 bytes.
+        let num_points = capacity / 100;
+        Self {
+            stack: Vec::with_capacity(8),
+            has_root: false,
+            coords: Vec::with_capacity(num_points * 16),
+            segment_sizes: Vec::new(),
+            elevations: Vec::with_capacity(num_points * 4),
+            times: Vec::with_capacity(num_points * 8),
+            segment_size: 0,
+            point: None,
+            elevation: f32::NAN,
+            time: NO_TIME,
+            text: String::new(),
+        }
+    }
+
+    fn start(&mut self, e: &BytesStart<'_>) -> PyResult<()> {
+        let local_name = e.local_name();
+        if self.stack.is_empty() {
+            self.has_root = true;
+        }
+        // Documents with a different root element contain no track points
+        let tag = match (self.stack.last(), local_name.as_ref()) {
+            (None, b"gpx") => Tag::Gpx,
+            (Some(Tag::Gpx), b"trk") => Tag::Trk,
+            (Some(Tag::Trk), b"trkseg") => {
+                self.segment_size = 0;
+                Tag::Trkseg
+            }
+            (Some(Tag::Trkseg), b"trkpt") => {
+                self.start_point(e)?;
+                Tag::Trkpt
+            }
+            (Some(Tag::Trkpt), b"ele") => Tag::Ele,
+            (Some(Tag::Trkpt), b"time") => Tag::Time,
+            _ => Tag::Other,
+        };
+        if matches!(tag, Tag::Ele | Tag::Time) {
+            self.text.clear();
+        }
+        self.stack.push(tag);
+        Ok(())
+    }
+
+    fn end(&mut self) -> PyResult<()> {
+        match self.stack.pop() {
+            Some(Tag::Trkseg) => self.finish_segment(),
+            Some(Tag::Trkpt) => self.finish_point(),
+            Some(Tag::Ele) => {
+                let text = self.text.trim();
+                if !text.is_empty() {
+                    self.elevation = parse_attr::<f32>(b"ele", text)?;
+                }
+            }
+            Some(Tag::Time) => {
+                let text = self.text.trim();
+                if !text.is_empty() {
+                    self.time = parse_time(text)?;
+                }
+            }
+            Some(_) => {}
+            None => {
+                return Err(PyValueError::new_err(
+                    "Error parsing XML: unexpected closing tag",
+                ));
+            }
+        }
+        Ok(())
+    }
+
+    fn in_text(&self) -> bool {
+        matches!(self.stack.last(), Some(Tag::Ele | Tag::Time))
+    }
+
+    fn start_point(&mut self, e: &BytesStart<'_>) -> PyResult<()> {
+        let mut lon = None;
+        let mut lat = None;
+        for_each_attr(e, |key, value| {
+            match key {
+                b"lon" => lon = Some(parse_attr::<f64>(key, value.trim())?),
+                b"lat" => lat = Some(parse_attr::<f64>(key, value.trim())?),
+                _ => {}
+            }
+            Ok(())
+        })?;
+
+        // Points without coordinates are skipped
+        self.point = lon.zip(lat);
+        self.elevation = f32::NAN;
+        self.time = NO_TIME;
+        Ok(())
+    }
+
+    fn finish_point(&mut self) {
+        let Some((lon, lat)) = self.point.take() else {
+            return;
+        };
+        self.coords.extend_from_slice(&lon.to_ne_bytes());
+        self.coords.extend_from_slice(&lat.to_ne_bytes());
+        self.elevations
+            .extend_from_slice(&self.elevation.to_ne_bytes());
+        self.times.extend_from_slice(&self.time.to_ne_bytes());
+        self.segment_size += 1;
+    }
+
+    fn finish_segment(&mut self) {
+        // Empty segments are skipped
+        if self.segment_size > 0 {
+            self.segment_sizes
+                .extend_from_slice(&self.segment_size.to_ne_bytes());
+        }
+    }
+}
+
+fn parse_digits(s: &[u8], start: usize, len: usize) -> Option<i64> {
+    let digits = s.get(start..start + len)?;
+    digits.iter().try_fold(0_i64, |acc, &c| {
+        c.is_ascii_digit().then(|| acc * 10 + i64::from(c - b'0'))
+    })
+}
+
+/// Days since 1970-01-01 of a proleptic Gregorian date.
+fn days_from_civil(year: i64, month: i64, day: i64) -> i64 {
+    let y = if month <= 2 { year - 1 } else { year };
+    let era = y.div_euclid(400);
+    let yoe = y - era * 400;
+    let mp = (month + 9) % 12;
+    let doy = (153 * mp + 2) / 5 + day - 1;
+    let doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    era * 146_097 + doe - 719_468
+}
+
+fn days_in_month(year: i64, month: i64) -> i64 {
+    match month {
+        2 if (year % 4 == 0 && year % 100 != 0) || year % 400 == 0 => 29,
+        2 => 28,
+        4 | 6 | 9 | 11 => 30,
+        _ => 31,
+    }
+}
+
+/// Parse an ISO 8601 timestamp into microseconds since the Unix epoch.
+/// Timestamps without an offset are treated as UTC.
+fn parse_time_opt(value: &str) -> Option<i64> {
+    let s = value.as_bytes();
+    let year = parse_digits(s, 0, 4)?;
+    let month = parse_digits(s, 5, 2)?;
+    let day = parse_digits(s, 8, 2)?;
+    let hour = parse_digits(s, 11, 2)?;
+    let minute = parse_digits(s, 14, 2)?;
+    if s[4] != b'-' || s[7] != b'-' || !matches!(s[10], b'T' | b't' | b' ') || s[13] != b':' {
+        return None;
+    }
+    if !(1..=12).contains(&month)
+        || !(1..=days_in_month(year, month)).contains(&day)
+        || hour > 23
+        || minute > 59
+    {
+        return None;
+    }
+
+    let mut i = 16;
+    let mut second = 0;
+    let mut micros = 0;
+    if s.get(i) == Some(&b':') {
+        second = parse_digits(s, i + 1, 2)?;
+        if second > 59 {
+            return None;
+        }
+        i += 3;
+        if matches!(s.get(i), Some(b'.' | b',')) {
+            i += 1;
+            let start = i;
+            while s.get(i).is_some_and(u8::is_ascii_digit) {
+                if i - start < 6 {
+                    micros = micros * 10 + i64::from(s[i] - b'0');
+                }
+                i += 1;
+            }
+            let num_digits = i - start;
+            if num_digits == 0 {
+                return None;
+            }
+            for _ in num_digits..6 {
+                micros *= 10;
+            }
+        }
+    }
+
+    let offset_seconds = match s.get(i) {
+        None => 0,
+        Some(b'Z' | b'z') if i + 1 == s.len() => 0,
+        Some(&sign @ (b'+' | b'-')) => {
+            let offset_hour = parse_digits(s, i + 1, 2)?;
+            let offset_minute = match s.get(i + 3) {
+                Some(b':') if i + 6 == s.len() => parse_digits(s, i + 4, 2)?,
+                Some(_) if i + 5 == s.len() => parse_digits(s, i + 3, 2)?,
+                None => 0,
+                _ => return None,
+            };
+            let offset = offset_hour * 3600 + offset_minute * 60;
+            if sign == b'+' { offset } else { -offset }
+        }
+        _ => return None,
+    };
+
+    let seconds = days_from_civil(year, month, day) * 86_400 + hour * 3600 + minute * 60 + second
+        - offset_seconds;
+    Some(seconds * 1_000_000 + micros)
+}
+
+fn parse_time(value: &str) -> PyResult<i64> {
+    parse_time_opt(value)
+        .ok_or_else(|| PyValueError::new_err(format!("Invalid isoformat string: {value:?}")))
+}
+
+fn decode(xml: &[u8]) -> PyResult<Decoder> {
+    let mut reader = Reader::from_reader(xml);
+    let mut decoder = Decoder::new(xml.len());
+
+    loop {
+        let event = reader
+            .read_event()
+            .map_err(|e| PyValueError::new_err(format!("Error parsing XML: {e}")))?;
+
+        match event {
+            Event::Start(e) => decoder.start(&e)?,
+            Event::Empty(e) => {
+                decoder.start(&e)?;
+                decoder.end()?;
+            }
+            Event::End(_) => decoder.end()?,
+            // Only <ele> and <time> text is needed, skip decoding anything else
+            Event::Text(e) if decoder.in_text() => {
+                let decoded = e
+                    .decode()
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                let unescaped = xml_unescape(decoded.as_ref())
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                decoder.text.push_str(&unescaped);
+            }
+            Event::CData(e) if decoder.in_text() => {
+                let decoded = e
+                    .decode()
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                decoder.text.push_str(&decoded);
+            }
+            Event::Eof => break,
+            _ => {}
+        }
+    }
+
+    if unlikely(!decoder.has_root) {
+        return Err(PyValueError::new_err("Document is empty"));
+    }
+    if unlikely(!decoder.stack.is_empty()) {
+        return Err(PyValueError::new_err(
+            "Error parsing XML: unexpected end of document",
+        ));
+    }
+    Ok(decoder)
+}
+
+/// Decode GPX track points into packed native-endian arrays:
+/// (lon, lat) f64 pairs, u64 segment sizes, f32 elevations (NaN if missing),
+/// and i64 epoch-microsecond times (i64::MIN if missing).
+/// The GIL is released while parsing, so multiple files can be decoded in parallel threads.
+#[pyfunction]
+#[pyo3(signature = (xml, /))]
+fn gpx_decode<'py>(py: Python<'py>, xml: &[u8]) -> PyResult<Bound<'py, PyTuple>> {
+    let decoder = py.detach(|| decode(xml))?;
+    PyTuple::new(
+        py,
+        [
+            PyBytes::new(py, &decoder.coords),
+            PyBytes::new(py, &decoder.segment_sizes),
+            PyBytes::new(py, &decoder.elevations),
+            PyBytes::new(py, &decoder.times),
+        ],
+    )
+}
+
+pub(crate) fn register(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_function(wrap_pyfunction!(gpx_decode, m)?)?;
+    Ok(())
+}
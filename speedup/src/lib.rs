@@ -1,7 +1,11 @@
 #![feature(likely_unlikely)]
 
 mod buffered_rand;
+mod element_copy;
 mod element_type;
+mod element_xml;
+mod gpx_decode;
+mod osmchange_decode;
 mod xattr;
 mod xml_parse;
 mod xml_unparse;
@@ -11,7 +15,11 @@ use pyo3::prelude::*;
 #[pymodule]
 fn speedup(m: &Bound<'_, PyModule>) -> PyResult<()> {
     buffered_rand::register(m)?;
+    element_copy::register(m)?;
     element_type::register(m)?;
+    element_xml::register(m)?;
+    gpx_decode::register(m)?;
+    osmchange_decode::register(m)?;
     xattr::register(m)?;
     xml_parse::register(m)?;
     xml_unparse::register(m)?;
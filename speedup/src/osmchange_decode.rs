@@ -0,0 +1,487 @@
+use std::borrow::Cow;
+use std::fmt::Display;
+use std::hint::unlikely;
+use std::str::FromStr;
+
+use ahash::AHashMap;
+use memchr::memrchr;
+use pyo3::exceptions::PyValueError;
+use pyo3::intern;
+use pyo3::prelude::*;
+use pyo3::types::{PyBytes, PyDict, PyList, PyString, PyTuple};
+use quick_xml::Reader;
+use quick_xml::events::{BytesStart, Event};
+
+use crate::element_type::{
+    NODE_TYPE_NUM, RELATION_TYPE_NUM, WAY_TYPE_NUM, type_num_from_str, typed_element_id_impl,
+};
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Action {
+    Create,
+    Modify,
+    Delete,
+}
+
+struct ElementState {
+    type_num: u64,
+    id: Option<i64>,
+    version: i64,
+    changeset_id: Option<i64>,
+    visible: bool,
+    lon: Option<f64>,
+    lat: Option<f64>,
+    tags: Option<Py<PyDict>>,
+    num_tags: usize,
+    members: Vec<u64>,
+    members_roles: Vec<Py<PyString>>,
+}
+
+struct Decoder {
+    changeset_id: Option<i64>,
+    /// Elements completed since the last take_output; point indices refer to it.
+    elements: Vec<Py<PyDict>>,
+    point_indices: Vec<u8>,
+    point_coords: Vec<u8>,
+    role_cache: AHashMap<Vec<u8>, Py<PyString>>,
+    has_root: bool,
+    /// Names of the open elements, concatenated, with their end offsets.
+    open_names: Vec<u8>,
+    open_name_ends: Vec<usize>,
+    action: Option<Action>,
+    delete_if_unused: bool,
+    element: Option<ElementState>,
+}
+
+pub(crate) fn for_each_attr(
+    e: &BytesStart<'_>,
+    mut f: impl FnMut(&[u8], Cow<'_, str>) -> PyResult<()>,
+) -> PyResult<()> {
+    e.attributes().try_for_each(|attr| {
+        let attr = attr.map_err(|e| PyValueError::new_err(e.to_string()))?;
+        let value = attr
+            .unescape_value()
+            .map_err(|e| PyValueError::new_err(e.to_string()))?;
+        f(attr.key.local_name().as_ref(), value)
+    })
+}
+
+pub(crate) fn parse_attr<T>(key: &[u8], value: &str) -> PyResult<T>
+where
+    T: FromStr,
+    T::Err: Display,
+{
+    value.parse().map_err(|e| {
+        PyValueError::new_err(format!(
+            "Invalid {} value {value:?}: {e}",
+            String::from_utf8_lossy(key)
+        ))
+    })
+}
+
+fn parse_bool(key: &[u8], value: &str) -> PyResult<bool> {
+    match value {
+        "true" => Ok(true),
+        "false" => Ok(false),
+        _ => Err(PyValueError::new_err(format!(
+            "Invalid {} value {value:?}: neither 'true' nor 'false'",
+            String::from_utf8_lossy(key)
+        ))),
+    }
+}
+
+fn missing_attr(element: &str, key: &str) -> PyErr {
+    PyValueError::new_err(format!("Missing {key} attribute on {element}"))
+}
+
+impl Decoder {
+    fn new(changeset_id: Option<i64>) -> Self {
+        Self {
+            changeset_id,
+            elements: Vec::new(),
+            point_indices: Vec::new(),
+            point_coords: Vec::new(),
+            role_cache: AHashMap::with_capacity(32),
+            has_root: false,
+            open_names: Vec::new(),
+            open_name_ends: Vec::new(),
+            action: None,
+            delete_if_unused: false,
+            element: None,
+        }
+    }
+
+    /// Decode the events of buf, returning the number of bytes consumed.
+    /// Unless is_final, the input is only parsed up to the last '<', and markup that
+    /// straddles the end is left for the next call, as in XMLStreamParser.
+    fn parse(&mut self, py: Python<'_>, buf: &[u8], is_final: bool) -> PyResult<usize> {
+        let end = if is_final {
+            buf.len()
+        } else {
+            memrchr(b'<', buf).unwrap_or(0)
+        };
+
+        let mut reader = Reader::from_reader(&buf[..end]);
+        // End tags may close elements opened in a previous chunk; names are checked in end.
+        reader.config_mut().check_end_names = false;
+        let mut consumed = 0;
+
+        loop {
+            let event = match reader.read_event() {
+                Ok(Event::Eof) => {
+                    consumed = end;
+                    break;
+                }
+                Ok(event) => event,
+                Err(_) if !is_final && reader.buffer_position() as usize >= end => break,
+                Err(e) => return Err(PyValueError::new_err(format!("Error parsing XML: {e}"))),
+            };
+
+            match event {
+                Event::Start(e) => self.start(py, &e)?,
+                Event::Empty(e) => {
+                    self.start(py, &e)?;
+                    self.end(py, e.local_name().as_ref())?;
+                }
+                Event::End(e) => self.end(py, e.local_name().as_ref())?,
+                _ => {}
+            }
+            consumed = reader.buffer_position() as usize;
+        }
+
+        Ok(consumed)
+    }
+
+    /// Verify the document is complete, after the final parse.
+    fn finish(&self) -> PyResult<()> {
+        if unlikely(!self.has_root) {
+            return Err(PyValueError::new_err("Document is empty"));
+        }
+        if unlikely(!self.open_name_ends.is_empty()) {
+            return Err(PyValueError::new_err(
+                "Error parsing XML: unexpected end of document",
+            ));
+        }
+        Ok(())
+    }
+
+    /// Return the elements completed so far, with their point indices and coordinates.
+    fn take_output<'py>(&mut self, py: Python<'py>) -> PyResult<Bound<'py, PyTuple>> {
+        let elements = PyList::new(py, self.elements.drain(..))?;
+        let result = PyTuple::new(
+            py,
+            [
+                elements.into_any(),
+                PyBytes::new(py, &self.point_indices).into_any(),
+                PyBytes::new(py, &self.point_coords).into_any(),
+            ],
+        )?;
+        self.point_indices.clear();
+        self.point_coords.clear();
+        Ok(result)
+    }
+
+    fn start(&mut self, py: Python<'_>, e: &BytesStart<'_>) -> PyResult<()> {
+        let local_name = e.local_name();
+        let name = local_name.as_ref();
+
+        match self.open_name_ends.len() {
+            0 => {
+                if unlikely(name != b"osmChange") {
+                    return Err(PyValueError::new_err(format!(
+                        "Not found osmChange element in the XML, got {}",
+                        String::from_utf8_lossy(name)
+                    )));
+                }
+                self.has_root = true;
+            }
+            1 => self.start_action(name, e)?,
+            2 => self.start_element(name, e)?,
+            3 => self.start_child(py, name, e)?,
+            // Deeper nesting carries no osmChange data.
+            _ => {}
+        }
+
+        self.open_names.extend_from_slice(name);
+        self.open_name_ends.push(self.open_names.len());
+        Ok(())
+    }
+
+    fn end(&mut self, py: Python<'_>, name: &[u8]) -> PyResult<()> {
+        let open_name = self.open_name_ends.pop().map(|end| {
+            let start = self.open_name_ends.last().copied().unwrap_or(0);
+            &self.open_names[start..end]
+        });
+        if unlikely(open_name != Some(name)) {
+            return Err(PyValueError::new_err(format!(
+                "Error parsing XML: unexpected closing tag </{}>",
+                String::from_utf8_lossy(name)
+            )));
+        }
+        self.open_names
+            .truncate(self.open_name_ends.last().copied().unwrap_or(0));
+
+        match self.open_name_ends.len() {
+            1 => self.action = None,
+            2 => self.finish_element(py)?,
+            _ => {}
+        }
+        Ok(())
+    }
+
+    fn start_action(&mut self, name: &[u8], e: &BytesStart<'_>) -> PyResult<()> {
+        let action = match name {
+            b"create" => Action::Create,
+            b"modify" => Action::Modify,
+            b"delete" => Action::Delete,
+            _ => {
+                return Err(PyValueError::new_err(format!(
+                    "Unknown action {}, choices are create, modify, delete",
+                    String::from_utf8_lossy(name)
+                )));
+            }
+        };
+
+        self.delete_if_unused = false;
+        if action == Action::Delete {
+            for_each_attr(e, |key, _| {
+                if key == b"if-unused" {
+                    self.delete_if_unused = true;
+                }
+                Ok(())
+            })?;
+        }
+
+        self.action = Some(action);
+        Ok(())
+    }
+
+    fn start_element(&mut self, name: &[u8], e: &BytesStart<'_>) -> PyResult<()> {
+        let type_s = str::from_utf8(name).map_err(|e| PyValueError::new_err(e.to_string()))?;
+        let mut state = ElementState {
+            type_num: type_num_from_str(type_s)?,
+            id: None,
+            version: 0,
+            changeset_id: None,
+            visible: true,
+            lon: None,
+            lat: None,
+            tags: None,
+            num_tags: 0,
+            members: Vec::new(),
+            members_roles: Vec::new(),
+        };
+
+        for_each_attr(e, |key, value| {
+            match key {
+                b"id" => state.id = Some(parse_attr(key, &value)?),
+                b"version" => state.version = parse_attr(key, &value)?,
+                b"changeset" => state.changeset_id = Some(parse_attr(key, &value)?),
+                b"lon" => state.lon = Some(parse_attr(key, &value)?),
+                b"lat" => state.lat = Some(parse_attr(key, &value)?),
+                b"visible" => state.visible = parse_bool(key, &value)?,
+                _ => {}
+            }
+            Ok(())
+        })?;
+
+        self.element = Some(state);
+        Ok(())
+    }
+
+    fn start_child(&mut self, py: Python<'_>, name: &[u8], e: &BytesStart<'_>) -> PyResult<()> {
+        let state = self.element.as_mut().expect("start_element sets element");
+
+        match name {
+            b"tag" => {
+                let mut k = None;
+                let mut v = None;
+                for_each_attr(e, |key, value| {
+                    match key {
+                        b"k" => k = Some(PyString::new(py, &value)),
+                        b"v" => v = Some(PyString::new(py, &value)),
+                        _ => {}
+                    }
+                    Ok(())
+                })?;
+                let k = k.ok_or_else(|| missing_attr("tag", "k"))?;
+                let v = v.ok_or_else(|| missing_attr("tag", "v"))?;
+                state
+                    .tags
+                    .get_or_insert_with(|| PyDict::new(py).unbind())
+                    .bind(py)
+                    .set_item(k, v)?;
+                state.num_tags += 1;
+            }
+            b"nd" if state.type_num == WAY_TYPE_NUM => {
+                let mut ref_ = None;
+                for_each_attr(e, |key, value| {
+                    if key == b"ref" {
+                        ref_ = Some(parse_attr(key, &value)?);
+                    }
+                    Ok(())
+                })?;
+                let ref_ = ref_.ok_or_else(|| missing_attr("nd", "ref"))?;
+                state
+                    .members
+                    .push(typed_element_id_impl(NODE_TYPE_NUM, ref_)?);
+            }
+            b"member" if state.type_num == RELATION_TYPE_NUM => {
+                let role_cache = &mut self.role_cache;
+                let mut type_num = None;
+                let mut ref_ = None;
+                let mut role = None;
+                for_each_attr(e, |key, value| {
+                    match key {
+                        b"type" => type_num = Some(type_num_from_str(&value)?),
+                        b"ref" => ref_ = Some(parse_attr(key, &value)?),
+                        b"role" => {
+                            // Roles repeat heavily (outer, inner, stop, ...); share the objects.
+                            let role_obj = role_cache
+                                .entry(value.as_bytes().to_vec())
+                                .or_insert_with(|| PyString::new(py, &value).unbind());
+                            role = Some(role_obj.clone_ref(py));
+                        }
+                        _ => {}
+                    }
+                    Ok(())
+                })?;
+                let type_num = type_num.ok_or_else(|| missing_attr("member", "type"))?;
+                let ref_ = ref_.ok_or_else(|| missing_attr("member", "ref"))?;
+                let role = role.ok_or_else(|| missing_attr("member", "role"))?;
+                state.members.push(typed_element_id_impl(type_num, ref_)?);
+                state.members_roles.push(role);
+            }
+            _ => {}
+        }
+
+        Ok(())
+    }
+
+    fn finish_element(&mut self, py: Python<'_>) -> PyResult<()> {
+        let state = self.element.take().expect("start_element sets element");
+        let action = self.action.expect("start_action sets action");
+
+        let id = state.id.ok_or_else(|| missing_attr("element", "id"))?;
+        let typed_id = typed_element_id_impl(state.type_num, id)?;
+
+        let (version, visible) = match action {
+            Action::Create => {
+                if unlikely(id > 0) {
+                    return Err(PyValueError::new_err(format!(
+                        "Cannot create element with positive id {id}"
+                    )));
+                }
+                (1, state.visible)
+            }
+            Action::Modify | Action::Delete => {
+                if unlikely(state.version < 1) {
+                    return Err(PyValueError::new_err(format!(
+                        "Update action requires version >= 1, got {}",
+                        state.version
+                    )));
+                }
+                (state.version + 1, state.visible && action != Action::Delete)
+            }
+        };
+
+        let changeset_id = self
+            .changeset_id
+            .or(state.changeset_id)
+            .ok_or_else(|| missing_attr("element", "changeset"))?;
+
+        let tags = match state.tags {
+            Some(tags) => {
+                if unlikely(tags.bind(py).len() != state.num_tags) {
+                    return Err(PyValueError::new_err("Duplicate tag keys"));
+                }
+                tags.into_any()
+            }
+            None => py.None(),
+        };
+
+        let (members, members_roles) = if state.members.is_empty() {
+            (py.None(), py.None())
+        } else if state.type_num == RELATION_TYPE_NUM {
+            (
+                PyList::new(py, state.members)?.into_any().unbind(),
+                PyList::new(py, state.members_roles)?.into_any().unbind(),
+            )
+        } else {
+            (
+                PyList::new(py, state.members)?.into_any().unbind(),
+                py.None(),
+            )
+        };
+
+        if let (Some(lon), Some(lat)) = (state.lon, state.lat) {
+            // Points are materialized in bulk on the Python side (shapely.points).
+            let index = self.elements.len() as u64;
+            self.point_indices.extend_from_slice(&index.to_ne_bytes());
+            self.point_coords.extend_from_slice(&lon.to_ne_bytes());
+            self.point_coords.extend_from_slice(&lat.to_ne_bytes());
+        }
+
+        let dict = PyDict::new(py);
+        dict.set_item(intern!(py, "changeset_id"), changeset_id)?;
+        dict.set_item(intern!(py, "typed_id"), typed_id)?;
+        dict.set_item(intern!(py, "version"), version)?;
+        dict.set_item(intern!(py, "visible"), visible)?;
+        dict.set_item(intern!(py, "tags"), tags)?;
+        dict.set_item(intern!(py, "point"), py.None())?;
+        dict.set_item(intern!(py, "members"), members)?;
+        dict.set_item(intern!(py, "members_roles"), members_roles)?;
+        if action == Action::Delete && self.delete_if_unused {
+            dict.set_item(intern!(py, "delete_if_unused"), true)?;
+        }
+
+        self.elements.push(dict.unbind());
+        Ok(())
+    }
+}
+
+/// Incremental osmChange decoder, producing ElementInit dicts as elements complete.
+#[pyclass]
+struct OSMChangeDecoder {
+    decoder: Decoder,
+    buf: Vec<u8>,
+}
+
+#[pymethods]
+impl OSMChangeDecoder {
+    #[new]
+    #[pyo3(signature = (changeset_id, /))]
+    fn new(changeset_id: Option<i64>) -> Self {
+        Self {
+            decoder: Decoder::new(changeset_id),
+            buf: Vec::new(),
+        }
+    }
+
+    /// Decode the next chunk and return the elements completed so far.
+    fn feed<'py>(&mut self, py: Python<'py>, chunk: &[u8]) -> PyResult<Bound<'py, PyTuple>> {
+        // Skip the copy when the previous chunk was consumed entirely
+        if self.buf.is_empty() {
+            let consumed = self.decoder.parse(py, chunk, false)?;
+            self.buf.extend_from_slice(&chunk[consumed..]);
+        } else {
+            self.buf.extend_from_slice(chunk);
+            let consumed = self.decoder.parse(py, &self.buf, false)?;
+            self.buf.drain(..consumed);
+        }
+        self.decoder.take_output(py)
+    }
+
+    /// Decode the remaining input and verify the document is complete.
+    fn close<'py>(&mut self, py: Python<'py>) -> PyResult<Bound<'py, PyTuple>> {
+        self.decoder.parse(py, &self.buf, true)?;
+        self.buf = Vec::new();
+        self.decoder.finish()?;
+        self.decoder.take_output(py)
+    }
+}
+
+pub(crate) fn register(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_class::<OSMChangeDecoder>()?;
+    Ok(())
+}
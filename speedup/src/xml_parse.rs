@@ -3,6 +3,7 @@ use std::borrow::Cow;
 use std::fmt::Display;
 use std::hint::unlikely;
 
+use memchr::memrchr;
 use pyo3::exceptions::PyValueError;
 use pyo3::prelude::*;
 use pyo3::types::{PyAny, PyBool, PyBytes, PyDict, PyList, PyString, PyTuple};
@@ -28,6 +29,11 @@ fn is_force_items(name: &str) -> bool {
     )
 }
 
+fn is_stream_action(name: &str) -> bool {
+    // osmChange actions are unwrapped when streaming, so a single large block is never buffered.
+    matches!(name, "create" | "delete" | "modify")
+}
+
 fn is_force_list(name: &str) -> bool {
     // Elements which are always represented as lists in the Python shape, even with a single entry.
     matches!(
@@ -52,13 +58,16 @@ struct ParseState {
     current_list: Option<Py<PyList>>,
     current_text: Option<String>,
     result: Option<Py<PyDict>>,
+    root_name: Option<Py<PyString>>,
+    stream: bool,
+    ready: Vec<(Py<PyString>, Py<PyAny>)>,
     tag_cache: AHashMap<Vec<u8>, Py<PyString>>,
     attr_cache: AHashMap<Vec<u8>, Py<PyString>>,
     text_key: Py<PyString>,
 }
 
 impl ParseState {
-    fn new(py: Python<'_>) -> Self {
+    fn new(py: Python<'_>, stream: bool) -> Self {
         Self {
             stack: Vec::with_capacity(STACK_SIZE),
             current_name: None,
@@ -66,6 +75,9 @@ impl ParseState {
             current_list: None,
             current_text: None,
             result: None,
+            root_name: None,
+            stream,
+            ready: Vec::new(),
             tag_cache: AHashMap::with_capacity(32),
             attr_cache: AHashMap::with_capacity(64),
             text_key: PyString::new(py, "#text").unbind(),
@@ -133,6 +145,9 @@ impl ParseState {
         }
 
         let name_obj = cached_name(py, &mut self.tag_cache, name_raw)?;
+        if self.root_name.is_none() {
+            self.root_name = Some(name_obj.clone_ref(py));
+        }
         self.current_name = Some(name_obj);
         self.current_text = None;
 
@@ -184,6 +199,17 @@ impl ParseState {
 
         if let Some((parent_name, mut parent_dict, mut parent_list, parent_text)) = self.stack.pop()
         {
+            let current_result = match current_result {
+                Some(child_value) if self.stream => self.stream_child(
+                    py,
+                    &parent_name,
+                    parent_dict.as_ref(),
+                    &end_name,
+                    child_value,
+                )?,
+                current_result => current_result,
+            };
+
             if let Some(child_value) = current_result {
                 if let Some(list) = parent_list.as_ref() {
                     // Already in list-of-pairs mode; keep child elements in document order.
@@ -241,6 +267,45 @@ impl ParseState {
         Ok(())
     }
 
+    fn stream_child(
+        &mut self,
+        py: Python<'_>,
+        parent_name: &Py<PyString>,
+        parent_dict: Option<&Py<PyDict>>,
+        name: &Py<PyString>,
+        value: Py<PyAny>,
+    ) -> PyResult<Option<Py<PyAny>>> {
+        match self.stack.len() {
+            // Direct child of the root element: hand it over instead of attaching it.
+            0 => {
+                if !is_stream_action(name.bind(py).to_str()?) {
+                    self.ready.push((name.clone_ref(py), value));
+                }
+                Ok(None)
+            }
+            // Element inside an osmChange action: emit it as a single-element action,
+            // preserving the action attributes (e.g. if-unused).
+            1 if is_stream_action(parent_name.bind(py).to_str()?) => {
+                let item = PyList::empty(py);
+                if let Some(dict) = parent_dict {
+                    dict.bind(py)
+                        .iter()
+                        .try_for_each(|(k, v)| -> PyResult<()> {
+                            let tuple = PyTuple::new(py, [k.unbind(), v.unbind()])?.unbind();
+                            item.append(tuple)?;
+                            Ok(())
+                        })?;
+                }
+                let tuple = PyTuple::new(py, [name.clone_ref(py).into_any(), value])?.unbind();
+                item.append(tuple)?;
+                self.ready
+                    .push((parent_name.clone_ref(py), item.unbind().into_any()));
+                Ok(None)
+            }
+            _ => Ok(Some(value)),
+        }
+    }
+
     fn handle_text(
         &mut self,
         py: Python<'_>,
@@ -295,6 +360,76 @@ impl ParseState {
 
         Ok(())
     }
+
+    fn handle_event(
+        &mut self,
+        py: Python<'_>,
+        event: Event<'_>,
+        datetime_fromisoformat: &Bound<'_, PyAny>,
+        parse_date: &Bound<'_, PyAny>,
+    ) -> PyResult<()> {
+        match event {
+            Event::Start(e) => {
+                let local_name = e.local_name();
+                let name_raw = local_name.as_ref();
+                self.start_element(
+                    py,
+                    name_raw,
+                    e.attributes(),
+                    datetime_fromisoformat,
+                    parse_date,
+                )?;
+            }
+            Event::Empty(e) => {
+                let local_name = e.local_name();
+                let name_raw = local_name.as_ref();
+                self.start_element(
+                    py,
+                    name_raw,
+                    e.attributes(),
+                    datetime_fromisoformat,
+                    parse_date,
+                )?;
+                self.finalize_element(py)?;
+            }
+            Event::Text(e) => {
+                let decoded = e
+                    .decode()
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                let unescaped = xml_unescape(decoded.as_ref())
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                self.handle_text(py, unescaped.as_ref(), datetime_fromisoformat, parse_date)?;
+            }
+            Event::CData(e) => {
+                let decoded = e
+                    .decode()
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+                self.handle_text(py, decoded.as_ref(), datetime_fromisoformat, parse_date)?;
+            }
+            Event::GeneralRef(e) => {
+                let decoded = e
+                    .decode()
+                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
+
+                // `BytesRef` data does not include the leading '&' (reader skips it) and
+                // slice reader also strips the trailing ';'. Reconstruct the full reference so
+                // we can reuse quick-xml's unescape implementation.
+                let mut reference = String::with_capacity(decoded.len() + 2);
+                reference.push('&');
+                reference.push_str(decoded.as_ref());
+                reference.push(';');
+
+                let resolved =
+                    xml_unescape(&reference).map_err(|e| PyValueError::new_err(e.to_string()))?;
+                self.handle_text(py, resolved.as_ref(), datetime_fromisoformat, parse_date)?;
+            }
+            Event::End(_e) => {
+                self.finalize_element(py)?;
+            }
+            _ => {}
+        }
+        Ok(())
+    }
 }
 
 fn value_to_string<'py>(value: &'py Bound<'py, PyAny>) -> PyResult<Cow<'py, str>> {
@@ -395,7 +530,7 @@ fn xml_parse(py: Python<'_>, xml: &Bound<'_, PyBytes>) -> PyResult<Py<PyAny>> {
         .getattr("parse_date")?;
 
     let mut reader = Reader::from_reader(xml.as_bytes());
-    let mut state = ParseState::new(py);
+    let mut state = ParseState::new(py, false);
     let mut buf = Vec::with_capacity(xml.as_bytes().len().min(1024));
 
     loop {
@@ -403,77 +538,137 @@ fn xml_parse(py: Python<'_>, xml: &Bound<'_, PyBytes>) -> PyResult<Py<PyAny>> {
         let event = reader
             .read_event_into(&mut buf)
             .map_err(|e| PyValueError::new_err(format!("Error parsing XML: {e}")))?;
+        if matches!(event, Event::Eof) {
+            break;
+        }
+        state.handle_event(py, event, &datetime_fromisoformat, &parse_date)?;
+    }
 
-        match event {
-            Event::Start(e) => {
-                let local_name = e.local_name();
-                let name_raw = local_name.as_ref();
-                state.start_element(
-                    py,
-                    name_raw,
-                    e.attributes(),
-                    &datetime_fromisoformat,
-                    &parse_date,
-                )?;
-            }
-            Event::Empty(e) => {
+    let out = state
+        .result
+        .ok_or_else(|| PyValueError::new_err("Document is empty"))?;
+    Ok(out.into_any())
+}
+
+#[pyclass]
+struct XMLStreamParser {
+    state: ParseState,
+    buf: Vec<u8>,
+    datetime_fromisoformat: Py<PyAny>,
+    parse_date: Py<PyAny>,
+}
+
+impl XMLStreamParser {
+    fn parse(&mut self, py: Python<'_>, is_final: bool) -> PyResult<Py<PyList>> {
+        let datetime_fromisoformat = self.datetime_fromisoformat.bind(py);
+        let parse_date = self.parse_date.bind(py);
+
+        // Only parse up to the last '<' until the input is complete: any markup before it
+        // is closed (except comments/CDATA, handled below) and text is never cut mid-way.
+        let end = if is_final {
+            self.buf.len()
+        } else {
+            memrchr(b'<', &self.buf).unwrap_or(0)
+        };
+
+        let mut reader = Reader::from_reader(&self.buf[..end]);
+        // End tags may close elements opened in a previous chunk; names are checked below.
+        reader.config_mut().check_end_names = false;
+        let mut consumed = 0;
+
+        loop {
+            let event = match reader.read_event() {
+                Ok(Event::Eof) => {
+                    consumed = end;
+                    break;
+                }
+                Ok(event) => event,
+                // Markup containing '<' may straddle the cut; retry once more data arrives.
+                Err(_) if !is_final && reader.buffer_position() as usize >= end => break,
+                Err(e) => return Err(PyValueError::new_err(format!("Error parsing XML: {e}"))),
+            };
+
+            if let Event::End(e) = &event {
                 let local_name = e.local_name();
-                let name_raw = local_name.as_ref();
-                state.start_element(
-                    py,
-                    name_raw,
-                    e.attributes(),
-                    &datetime_fromisoformat,
-                    &parse_date,
-                )?;
-                state.finalize_element(py)?;
-            }
-            Event::Text(e) => {
-                let decoded = e
-                    .decode()
-                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
-                let unescaped = xml_unescape(decoded.as_ref())
-                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
-                state.handle_text(py, unescaped.as_ref(), &datetime_fromisoformat, &parse_date)?;
-            }
-            Event::CData(e) => {
-                let decoded = e
-                    .decode()
-                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
-                state.handle_text(py, decoded.as_ref(), &datetime_fromisoformat, &parse_date)?;
+                let expected = self
+                    .state
+                    .current_name
+                    .as_ref()
+                    .map(|name| name.bind(py).to_str())
+                    .transpose()?;
+                if unlikely(expected.map(str::as_bytes) != Some(local_name.as_ref())) {
+                    return Err(PyValueError::new_err(format!(
+                        "Error parsing XML: unexpected closing tag </{}>",
+                        String::from_utf8_lossy(local_name.as_ref())
+                    )));
+                }
             }
-            Event::GeneralRef(e) => {
-                let decoded = e
-                    .decode()
-                    .map_err(|e| PyValueError::new_err(e.to_string()))?;
 
-                // `BytesRef` data does not include the leading '&' (reader skips it) and
-                // slice reader also strips the trailing ';'. Reconstruct the full reference so
-                // we can reuse quick-xml's unescape implementation.
-                let mut reference = String::with_capacity(decoded.len() + 2);
-                reference.push('&');
-                reference.push_str(decoded.as_ref());
-                reference.push(';');
+            self.state
+                .handle_event(py, event, datetime_fromisoformat, parse_date)?;
+            consumed = reader.buffer_position() as usize;
+        }
 
-                let resolved =
-                    xml_unescape(&reference).map_err(|e| PyValueError::new_err(e.to_string()))?;
-                state.handle_text(py, resolved.as_ref(), &datetime_fromisoformat, &parse_date)?;
-            }
-            Event::End(_e) => {
-                state.finalize_element(py)?;
-            }
-            Event::Eof => break,
-            _ => {}
+        self.buf.drain(..consumed);
+
+        let out = PyList::empty(py);
+        self.state
+            .ready
+            .drain(..)
+            .try_for_each(|(name, value)| -> PyResult<()> {
+                let tuple = PyTuple::new(py, [name.into_any(), value])?.unbind();
+                out.append(tuple)?;
+                Ok(())
+            })?;
+        Ok(out.unbind())
+    }
+}
+
+#[pymethods]
+impl XMLStreamParser {
+    #[new]
+    fn new(py: Python<'_>) -> PyResult<Self> {
+        let datetime = py.import("datetime")?.getattr("datetime")?;
+        Ok(Self {
+            state: ParseState::new(py, true),
+            buf: Vec::new(),
+            datetime_fromisoformat: datetime.getattr("fromisoformat")?.unbind(),
+            parse_date: py
+                .import("app.lib.time.date_utils")?
+                .getattr("parse_date")?
+                .unbind(),
+        })
+    }
+
+    /// Parse the next chunk and return the top-level children completed so far.
+    fn feed(&mut self, py: Python<'_>, chunk: &[u8]) -> PyResult<Py<PyList>> {
+        self.buf.extend_from_slice(chunk);
+        self.parse(py, false)
+    }
+
+    /// Parse the remaining input and verify the document is complete.
+    fn close(&mut self, py: Python<'_>) -> PyResult<Py<PyList>> {
+        let out = self.parse(py, true)?;
+        if unlikely(self.state.current_name.is_some()) {
+            return Err(PyValueError::new_err(
+                "Error parsing XML: unexpected end of document",
+            ));
         }
+        if unlikely(self.state.root_name.is_none()) {
+            return Err(PyValueError::new_err("Document is empty"));
+        }
+        Ok(out)
     }
 
-    let out = state
-        .result
-        .ok_or_else(|| PyValueError::new_err("Document is empty"))?;
-    Ok(out.into_any())
+    /// Name of the root element, once its start tag has been parsed.
+    #[getter]
+    fn root(&self, py: Python<'_>) -> Option<Py<PyString>> {
+        self.state.root_name.as_ref().map(|name| name.clone_ref(py))
+    }
 }
 
 pub(crate) fn register(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_class::<XMLStreamParser>()?;
     m.add_function(wrap_pyfunction!(xml_parse, m)?)?;
     Ok(())
 }
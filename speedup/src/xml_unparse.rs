@@ -46,7 +46,7 @@ fn escape_text(s: &str) -> Cow<'_, str> {
     escape_xml::<false>(s)
 }
 
-fn escape_attr(s: &str) -> Cow<'_, str> {
+pub(crate) fn escape_attr(s: &str) -> Cow<'_, str> {
     escape_xml::<true>(s)
 }
 
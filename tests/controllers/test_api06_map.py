@@ -66,6 +66,21 @@ async def test_map_read(client: AsyncClient):
         },
     )
 
+    # Retrieve the node in JSON format
+    r = await client.get('/api/0.6/map.json', params={'bbox': bbox})
+    assert r.is_success, r.text
+
+    map_data = r.json()
+    assert map_data['version'] == '0.6'
+    assert map_data['bounds']['minlon'] == lon
+    target_node = next(
+        (e for e in map_data['elements'] if e['type'] == 'node' and e['id'] == node_id),
+        None,
+    )
+    assert target_node is not None, 'Created node must be found in map response'
+    assert target_node['lon'] == lon
+    assert target_node['lat'] == lat
+
     # Delete the node
     r = await client.request(
         'DELETE',
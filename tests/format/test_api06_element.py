@@ -0,0 +1,173 @@
+from datetime import UTC, datetime
+
+import pytest
+from shapely import Point
+
+from app.exceptions.api06 import Exceptions06
+from app.exceptions.api_error import APIError
+from app.exceptions.context import exceptions_context
+from app.format import Format06
+from app.lib.io.xml_codec import XMLToDict
+from app.lib.render import format_style
+from speedup import typed_element_id
+
+
+@pytest.mark.parametrize('changeset_id', [None, 5])
+def test_decode_osmchange_xml(changeset_id):
+    xml = (
+        b'<osmChange version="0.6">'
+        b'<create>'
+        b'<node id="-1" changeset="1" lat="1.123456789" lon="2"><tag k="a" v="&amp;"/></node>'
+        b'<way id="-2" changeset="1"><nd ref="-1"/><nd ref="3"/></way>'
+        b'</create>'
+        b'<modify>'
+        b'<relation id="4" version="2" changeset="1">'
+        b'<member type="node" ref="-1" role="stop"/><member type="way" ref="-2" role=""/>'
+        b'</relation>'
+        b'</modify>'
+        b'<delete if-unused="true"><node id="5" version="1" changeset="1"/></delete>'
+        b'</osmChange>'
+    )
+    expected = Format06.decode_osmchange(
+        changeset_id, XMLToDict.parse(xml)['osmChange']
+    )
+    assert Format06.decode_osmchange_xml(changeset_id, xml) == expected
+
+
+@pytest.mark.parametrize(
+    'xml',
+    [
+        b'<osm><create><node id="-1" changeset="1"/></create></osm>',
+        b'<osmChange><upsert><node id="-1" changeset="1"/></upsert></osmChange>',
+        b'<osmChange><create><node id="1" changeset="1"/></create></osmChange>',
+        b'<osmChange><modify><node id="1" changeset="1"/></modify></osmChange>',
+        b'<osmChange><create><node id="-1"/></create></osmChange>',
+        b'<osmChange><create><node id="-1" changeset="1"><tag k="a" v="1"/><tag k="a" v="2"/></node></create></osmChange>',
+        b'<osmChange><create><node id="-1" changeset="1">',
+    ],
+)
+def test_decode_osmchange_xml_invalid(xml):
+    with pytest.raises(ValueError):
+        Format06.decode_osmchange_xml(None, xml)
+
+
+@pytest.mark.parametrize('chunk_size', [1, 7, 64])
+async def test_decode_osmchange_aiter(chunk_size):
+    xml = (
+        b'<osmChange version="0.6">'
+        b'<create>'
+        b'<node id="-1" changeset="1" lat="1" lon="2"><tag k="a" v="&amp;b"/></node>'
+        b'<node id="-2" changeset="1" lat="3" lon="4"/>'
+        b'<way id="-3" changeset="1"><nd ref="-1"/><nd ref="-2"/></way>'
+        b'</create>'
+        b'<!-- a <comment> -->'
+        b'<delete><node id="5" version="1" changeset="1"/></delete>'
+        b'</osmChange>'
+    )
+
+    async def chunks():
+        for i in range(0, len(xml), chunk_size):
+            yield xml[i : i + chunk_size]
+
+    elements = await Format06.decode_osmchange_aiter(None, chunks())
+    assert elements == Format06.decode_osmchange_xml(None, xml)
+    assert [element['point'] for element in elements] == [
+        Point(2, 1),
+        Point(4, 3),
+        None,
+        None,
+    ]
+
+
+@pytest.mark.parametrize(
+    'chunks',
+    [
+        [b'<osm>', b'<create/></osm>'],
+        [b'<osmChange><create>', b'<node id="-1" changeset="1"></way>'],
+        [b'<osmChange><create><node id="-1" changeset="1"/>'],
+        [b'<osmChange><create><bogus/></create></osmChange>'],
+        [
+            b'<osmChange><modify><relation id="1" version="1" changeset="1">',
+            b'<member type="foo" ref="1" role=""/></relation></modify></osmChange>',
+        ],
+        [
+            b'<osmChange><create>',
+            b'<node id="-9223372036854775807" changeset="1"/></create></osmChange>',
+        ],
+    ],
+)
+async def test_decode_osmchange_aiter_invalid(chunks):
+    async def aiter():
+        for chunk in chunks:
+            yield chunk
+
+    with (
+        exceptions_context(Exceptions06()),
+        pytest.raises(APIError, match='Cannot parse valid osmChange') as e,
+    ):
+        await Format06.decode_osmchange_aiter(None, aiter())
+    assert e.value.status_code == 400
+
+
+def _make_element(type, id, version, *, visible=True, **kwargs):
+    return {
+        'sequence_id': 1,
+        'changeset_id': 7,
+        'typed_id': typed_element_id(type, id),
+        'version': version,
+        'visible': visible,
+        'tags': None,
+        'point': None,
+        'members': None,
+        'members_roles': None,
+        'latest': True,
+        'created_at': datetime(2024, 1, 2, 3, 4, 5, 678901, UTC),
+        **kwargs,
+    }
+
+
+_ELEMENTS = [
+    _make_element(
+        'relation',
+        4,
+        2,
+        members=[typed_element_id('node', 1), typed_element_id('way', 2)],
+        members_roles=['stop', 'a"b'],
+    ),
+    _make_element(
+        'node',
+        1,
+        1,
+        tags={'name': '<&>"', 'a': ''},
+        point=Point(2, 1.1234567),
+        user_id=3,
+        user={'id': 3, 'display_name': 'x&y', 'avatar_url': ''},
+    ),
+    _make_element('way', 2, 3, members=[typed_element_id('node', 1)]),
+    _make_element('node', 5, 2, visible=False),
+    _make_element('node', 6, 1, point=Point(-179.9999999, -90)),
+]
+
+
+def test_encode_elements_xml(monkeypatch):
+    monkeypatch.setattr(format_style, 'is_json', lambda: False)
+    expected = XMLToDict.unparse(
+        {'osm': Format06.encode_elements(_ELEMENTS)}, binary=True
+    )
+    assert expected == Format06.encode_elements_xml(
+        _ELEMENTS,
+        head=b"<?xml version='1.0' encoding='UTF-8'?>\n<osm>",
+        tail=b'</osm>\n',
+    )
+
+
+def test_encode_elements_xml_osmchange():
+    expected = XMLToDict.unparse(
+        {'osmChange': Format06.encode_osmchange(_ELEMENTS)}, binary=True
+    )
+    assert expected == Format06.encode_elements_xml(
+        _ELEMENTS,
+        osmchange=True,
+        head=b"<?xml version='1.0' encoding='UTF-8'?>\n<osmChange>",
+        tail=b'</osmChange>\n',
+    )
@@ -0,0 +1,89 @@
+from datetime import UTC, datetime, timedelta, timezone
+from pathlib import Path
+
+import pytest
+from shapely import get_coordinates
+
+from app.format.gpx import FormatGPX
+from app.lib.io.xml_codec import XMLToDict
+from speedup import gpx_decode
+
+
+def test_decode_tracks_matches_xml_parse():
+    data = Path('tests/data/8473730.gpx').read_bytes()
+    decoded = FormatGPX.decode_tracks([gpx_decode(data)])
+
+    points = [
+        point
+        for track in XMLToDict.parse(data)['gpx']['trk']
+        for segment in track['trkseg']
+        for point in segment['trkpt']
+    ]
+    assert decoded.size == len(points)
+    assert get_coordinates(decoded.segments).tolist() == [
+        [point['@lon'], point['@lat']] for point in points
+    ]
+    assert decoded.elevations == pytest.approx([point['ele'] for point in points])
+    assert decoded.capture_times == [point['time'] for point in points]
+
+
+def test_decode_tracks_segments():
+    data = (
+        b'<gpx><trk>'
+        b'<trkseg><trkpt lon="1" lat="2"/><trkpt lon="3" lat="4"/></trkseg>'
+        b'<trkseg/>'
+        b'<trkseg>'
+        b'<trkpt lon="5" lat="6"><ele> 7.5 </ele></trkpt>'
+        b'<trkpt lat="0"/>'
+        b'<trkpt lon="7" lat="8"><time>2024-01-02T03:04:05.5+01:30</time></trkpt>'
+        b'</trkseg>'
+        b'</trk></gpx>'
+    )
+    decoded = FormatGPX.decode_tracks([gpx_decode(data), gpx_decode(b'<osm/>')])
+
+    assert decoded.size == 4
+    assert [g.coords[:] for g in decoded.segments.geoms] == [
+        [(1, 2), (3, 4)],
+        [(5, 6), (7, 8)],
+    ]
+    assert decoded.elevations == [None, None, 7.5, None]
+    assert decoded.capture_times == [
+        None,
+        None,
+        None,
+        datetime(
+            2024, 1, 2, 3, 4, 5, 500000, timezone(timedelta(hours=1, minutes=30))
+        ).astimezone(UTC),
+    ]
+
+
+@pytest.mark.parametrize(
+    'data',
+    [
+        b'<gpx><trk><trkseg><trkpt lon="1" lat="2"/></trkseg></trk></gpx>',
+        b'<gpx><trk><trkseg></trkseg></trk></gpx>',
+        b'<osm/>',
+    ],
+)
+def test_decode_tracks_too_short(data):
+    with pytest.raises(Exception, match='too short'):
+        FormatGPX.decode_tracks([gpx_decode(data)])
+
+
+@pytest.mark.parametrize(
+    'data',
+    [
+        b'<gpx><trk><trkseg><trkpt lon="x" lat="2"/></trkseg></trk></gpx>',
+        b'<gpx><trk><trkseg><trkpt lon="1" lat="2"><ele>x</ele></trkpt>'
+        b'</trkseg></trk></gpx>',
+        b'<gpx><trk><trkseg><trkpt lon="1" lat="2"><time>yesterday</time></trkpt>'
+        b'</trkseg></trk></gpx>',
+        b'<gpx><trk><trkseg><trkpt lon="1" lat="2"><time>2024-02-30T00:00:00Z</time>'
+        b'</trkpt></trkseg></trk></gpx>',
+        b'<gpx><trk><trkseg>',
+        b'',
+    ],
+)
+def test_gpx_decode_invalid(data):
+    with pytest.raises(ValueError):
+        gpx_decode(data)
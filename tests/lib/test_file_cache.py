@@ -2,7 +2,7 @@ from datetime import timedelta
 
 import pytest
 
-from app.lib.io.file_cache import FileCache
+from app.lib.io.file_cache import FileCache, _MemoryEntry, _SharedMemory
 from app.models.types import StorageKey
 
 
@@ -91,3 +91,66 @@ async def test_memory_cache_file_bound():
 
     # Without the backing file, the cache should report a miss
     assert await cache.get(key) is None
+
+
+async def test_shared_memory_across_processes(tmp_path):
+    key = StorageKey('shared_key')
+    path = tmp_path.joinpath('shared')
+    writer = FileCache('test')
+    reader = FileCache('test')
+    # Separate mappings of the same file, as seen by two worker processes
+    writer._shared_memory = _SharedMemory(path, 1024 * 1024, 1024)  # noqa: SLF001
+    reader._shared_memory = _SharedMemory(path, 1024 * 1024, 1024)  # noqa: SLF001
+
+    async with writer.lock(key) as lock:
+        await writer.set(lock, b'value', ttl=None)
+
+    digest = reader._digest(key)  # noqa: SLF001
+    entry = reader._shared_memory.get(digest)  # noqa: SLF001
+    assert entry is not None
+    assert entry.data == b'value'
+    assert await reader.get(key) == b'value'
+
+    # Deleting clears the slot for everyone
+    writer.delete(key)
+    assert reader._shared_memory.get(digest) is None  # noqa: SLF001
+    assert await reader.get(key) is None
+
+
+async def test_shared_memory_busy_keeps_process_entry(tmp_path):
+    class BusySharedMemory(_SharedMemory):
+        def set(self, digest, entry):
+            return False
+
+    key = StorageKey('busy_key')
+    cache = FileCache('test')
+    cache._shared_memory = BusySharedMemory(  # noqa: SLF001
+        tmp_path.joinpath('shared'), 1024 * 1024, 1024
+    )
+
+    async with cache.lock(key) as lock:
+        await cache.set(lock, b'value', ttl=None)
+
+    assert key in cache._memory_cache  # noqa: SLF001
+    assert await cache.get(key) == b'value'
+
+
+def test_shared_memory_layout_change(tmp_path):
+    path = tmp_path.joinpath('shared')
+    digest = bytes(range(16))
+    old = _SharedMemory(path, 1024 * 1024, 1024)
+    assert old.set(digest, _MemoryEntry(None, b'value', 1.0))
+
+    # A different layout replaces the file, without resizing the old mapping
+    new = _SharedMemory(path, 1024 * 1024, 2048)
+    assert new.get(digest) is None
+    entry = old.get(digest)
+    assert entry is not None
+    assert entry.data == b'value'
+
+
+def test_shared_memory_foreign_file(tmp_path):
+    path = tmp_path.joinpath('shared')
+    path.write_bytes(b'not a cache file')
+    with pytest.raises(ValueError, match='not a shared memory cache file'):
+        _SharedMemory(path, 1024 * 1024, 1024)
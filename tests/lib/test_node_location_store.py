@@ -0,0 +1,42 @@
+import numpy as np
+from shapely import Point
+
+from app.lib.geo import node_location_store
+from app.lib.geo.node_location_store import NodeLocationStore
+from app.models.element import TypedElementId
+
+
+async def test_node_location_store(tmp_path):
+    await node_location_store._open(tmp_path / 'nodes.bin')
+    try:
+        node_location_store._apply([
+            (TypedElementId(1), Point(0, 0)),
+            (TypedElementId(2), Point(1, 2)),
+            (TypedElementId(1), Point(-179.9999999, 89.1234567)),
+            (TypedElementId(3), Point(5, 5)),
+            (TypedElementId(3), None),
+            # Grows the file
+            (TypedElementId(1 << 25), Point(180, -90)),
+        ])
+        coords = NodeLocationStore.get_coordinates([
+            TypedElementId(1),
+            TypedElementId(2),
+            TypedElementId(3),
+            TypedElementId(4),
+            TypedElementId(1 << 25),
+            TypedElementId(1 << 30),
+        ])
+    finally:
+        node_location_store._close()
+
+    np.testing.assert_array_equal(
+        coords,
+        [
+            [-179.9999999, 89.1234567],
+            [1, 2],
+            [np.nan, np.nan],
+            [np.nan, np.nan],
+            [180, -90],
+            [np.nan, np.nan],
+        ],
+    )
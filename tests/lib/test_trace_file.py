@@ -1,3 +1,12 @@
+from compression import zstd
+from io import BytesIO
+from zipfile import ZIP_DEFLATED, ZIP_STORED, ZipFile
+
+import pytest
+
+from app.exceptions.api06 import Exceptions06
+from app.exceptions.api_error import APIError
+from app.exceptions.context import exceptions_context
 from app.lib.io.trace_file import TraceFile
 from app.models.types import StorageKey
 
@@ -9,3 +18,74 @@ async def test_trace_file_compression():
         == b'hello'
     )
     assert TraceFile.decompress_if_needed(result.data, StorageKey('test')) != b'hello'
+
+
+async def _collect(chunks):
+    return [chunk async for chunk in chunks]
+
+
+async def _split(data: bytes, size: int):
+    for i in range(0, len(data), size):
+        yield data[i : i + size]
+
+
+@pytest.mark.parametrize('input_chunk_size', [1, 1000, 1 << 30])
+async def test_trace_file_decompress_stream(input_chunk_size):
+    data = bytes(range(256)) * 4096
+    compressed = zstd.compress(data[:100_000]) + zstd.compress(data[100_000:])
+    chunks = await _collect(
+        TraceFile.decompress_stream_if_needed(
+            _split(compressed, input_chunk_size), StorageKey('test.zst')
+        )
+    )
+    assert b''.join(chunks) == data
+    assert max(map(len, chunks)) <= 256 * 1024
+
+
+async def test_trace_file_decompress_stream_truncated():
+    compressed = zstd.compress(b'hello' * 1000)
+    with pytest.raises(zstd.ZstdError):
+        await _collect(
+            TraceFile.decompress_stream_if_needed(
+                _split(compressed[:-4], 100), StorageKey('test.zst')
+            )
+        )
+
+
+async def test_trace_file_decompress_stream_uncompressed():
+    chunks = await _collect(
+        TraceFile.decompress_stream_if_needed(_split(b'hello', 2), StorageKey('test'))
+    )
+    assert chunks == [b'he', b'll', b'o']
+
+
+async def test_trace_file_extract_decode_zip():
+    files = [
+        f'<?xml version="1.0"?><gpx><trk><name>{i}</name></trk></gpx>'.encode()
+        for i in range(5)
+    ]
+    buffer = BytesIO()
+    with ZipFile(buffer, 'w', ZIP_DEFLATED) as archive:
+        archive.mkdir('traces')
+        for i, data in enumerate(files):
+            archive.writestr(f'traces/{i}.gpx', data)
+
+    result = await TraceFile.extract_decode(buffer.getvalue(), bytes.upper)
+    assert result == [data.upper() for data in files]
+
+
+async def test_trace_file_extract_decode_zip_corrupted():
+    data = b'<?xml version="1.0"?><gpx><trk><name>1</name></trk></gpx>'
+    buffer = BytesIO()
+    with ZipFile(buffer, 'w', ZIP_STORED) as archive:
+        archive.writestr('1.gpx', data)
+
+    # The archive lists fine, but the member fails its checksum in the worker
+    corrupted = buffer.getvalue().replace(data, data.upper())
+
+    with (
+        exceptions_context(Exceptions06()),
+        pytest.raises(APIError, match='failed to decompress') as e,
+    ):
+        await TraceFile.extract_decode(corrupted, bytes.upper)
+    assert e.value.status_code == 400
@@ -2,6 +2,9 @@ from datetime import UTC, datetime
 
 import pytest
 
+from app.exceptions.api06 import Exceptions06
+from app.exceptions.api_error import APIError
+from app.exceptions.context import exceptions_context
 from app.lib.io.xml_codec import XMLToDict, get_xattr
 from speedup import CDATA
 
@@ -116,3 +119,60 @@ def test_xml_unparse_xattr():
 def test_xml_unparse_invalid_multi_root():
     with pytest.raises(ValueError):
         XMLToDict.unparse({'root1': {}, 'root2': {}})
+
+
+@pytest.mark.parametrize('chunk_size', [1, 7, 1024])
+def test_xml_parse_iter(chunk_size):
+    xml = (
+        b'<?xml version="1.0"?><osmChange version="0.6">'
+        b'<create><node id="-1" lat="1" lon="2"><tag k="a" v="&lt;b&gt;"/></node>'
+        b'<!-- <comment> --><way id="-2"><nd ref="-1"/></way></create>'
+        b'<delete if-unused="true"><node id="3" version="1"/></delete>'
+        b'</osmChange>'
+    )
+    chunks = [xml[i : i + chunk_size] for i in range(0, len(xml), chunk_size)]
+    assert list(XMLToDict.parse_iter(chunks)) == [
+        (
+            'create',
+            [
+                (
+                    'node',
+                    {
+                        '@id': -1,
+                        '@lat': 1,
+                        '@lon': 2,
+                        'tag': [{'@k': 'a', '@v': '<b>'}],
+                    },
+                )
+            ],
+        ),
+        ('create', [('way', {'@id': -2, 'nd': [{'@ref': -1}]})]),
+        ('delete', [('@if-unused', 'true'), ('node', {'@id': 3, '@version': 1})]),
+    ]
+
+
+@pytest.mark.parametrize(
+    'input',
+    [
+        b'<osm><node id="1"/>',
+        b'<osm><node id="1"></way></osm>',
+        b'',
+    ],
+)
+def test_xml_parse_iter_invalid(input):
+    with (
+        exceptions_context(Exceptions06()),
+        pytest.raises(APIError, match='Cannot parse valid data') as e,
+    ):
+        list(XMLToDict.parse_iter([input]))
+    assert e.value.status_code == 400
+
+
+def test_xml_parse_iter_invalid_offset():
+    chunks = [b'<osm><node id="1"/>', b'<way id="2">', b'</node></osm>']
+    with (
+        exceptions_context(Exceptions06()),
+        pytest.raises(APIError, match=r'byte offset 31\)'),
+    ):
+        list(XMLToDict.parse_iter(chunks))
+
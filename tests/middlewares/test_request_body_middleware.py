@@ -225,3 +225,102 @@ async def test_size_limit_after_decompression(
 
     # Verify response
     assert r.status_code == status.HTTP_413_CONTENT_TOO_LARGE, r.text
+
+
+@pytest.mark.parametrize(
+    ('encoding', 'compress'),
+    _ENCODING_COMPRESS,
+)
+async def test_compressed_streaming_upload(
+    client: AsyncClient,
+    changeset_id: ChangesetId,
+    encoding: str,
+    compress: Callable[[bytes], bytes],
+):
+    client.headers['Authorization'] = 'User user1'
+
+    # Setup test data
+    content = XMLToDict.unparse(
+        {
+            'osmChange': {
+                'create': [
+                    ('node', {'@id': -1, '@lat': 0, '@lon': 0}),
+                    ('node', {'@id': -2, '@lat': 1, '@lon': 1}),
+                ]
+            }
+        },
+        binary=True,
+    )
+
+    # Execute request with the body sent in small network chunks
+    data = compress(content)
+
+    async def chunks():
+        for i in range(0, len(data), 16):
+            yield data[i : i + 16]
+
+    r = await client.post(
+        f'/api/0.6/changeset/{changeset_id}/upload',
+        content=chunks(),
+        headers={
+            'Content-Encoding': encoding,
+            'Content-Type': 'application/xml',
+        },
+    )
+
+    # Verify response
+    assert r.is_success, r.text
+    diff: dict = XMLToDict.parse(r.content)['diffResult']
+    assert [node['@old_id'] for node in diff['node']] == [-1, -2]
+
+
+@pytest.mark.extended
+@pytest.mark.parametrize(
+    ('encoding', 'compress'),
+    _ENCODING_COMPRESS,
+)
+async def test_size_limit_after_decompression_streaming_upload(
+    client: AsyncClient,
+    changeset_id: ChangesetId,
+    encoding: str,
+    compress: Callable[[bytes], bytes],
+):
+    client.headers['Authorization'] = 'User user1'
+
+    # Small when compressed, but exceeds the limits when decompressed
+    content = compress(b'<osmChange>' + b' ' * REQUEST_BODY_MAX_SIZE + b'</osmChange>')
+    assert len(content) < REQUEST_BODY_MAX_SIZE, (
+        'Compressed content must be under size limit'
+    )
+
+    # Execute request
+    r = await client.post(
+        f'/api/0.6/changeset/{changeset_id}/upload',
+        content=content,
+        headers={
+            'Content-Encoding': encoding,
+            'Content-Type': 'application/xml',
+        },
+    )
+
+    # Verify response
+    assert r.status_code == status.HTTP_413_CONTENT_TOO_LARGE, r.text
+
+
+async def test_bad_compression_streaming_upload(
+    client: AsyncClient,
+    changeset_id: ChangesetId,
+):
+    client.headers['Authorization'] = 'User user1'
+
+    r = await client.post(
+        f'/api/0.6/changeset/{changeset_id}/upload',
+        content=b'Bad compressed data',  # Intentionally corrupted data
+        headers={
+            'Content-Encoding': 'gzip',
+            'Content-Type': 'application/xml',
+        },
+    )
+
+    # Verify response
+    assert r.status_code == status.HTTP_400_BAD_REQUEST, r.text
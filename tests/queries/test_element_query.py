@@ -0,0 +1,50 @@
+from asyncio import sleep
+from contextlib import aclosing
+
+import pytest
+
+from app.queries.element_query import _read_ahead
+
+
+async def test_read_ahead_releases_producer_early():
+    finished = False
+
+    async def chunks():
+        nonlocal finished
+        yield 1
+        yield 2
+        finished = True
+
+    async with aclosing(_read_ahead(chunks())) as it:
+        assert await anext(it) == 1
+        # The producer completes without waiting for the consumer
+        await sleep(0)
+        assert finished
+        assert [chunk async for chunk in it] == [2]
+
+
+async def test_read_ahead_propagates_errors():
+    async def chunks():
+        yield 1
+        raise ValueError('boom')
+
+    with pytest.raises(ValueError, match='boom'):
+        [chunk async for chunk in _read_ahead(chunks())]
+
+
+async def test_read_ahead_bounds_buffered_items():
+    produced = 0
+
+    async def chunks():
+        nonlocal produced
+        for i in range(5):
+            produced += 1
+            yield i
+
+    async with aclosing(_read_ahead(chunks())) as it:
+        assert await anext(it) == 0
+        for _ in range(10):
+            await sleep(0)
+        # One item waits for the consumer, the next one waits for space
+        assert produced == 3
+        assert [chunk async for chunk in it] == [1, 2, 3, 4]
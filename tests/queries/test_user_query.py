@@ -0,0 +1,23 @@
+from app.models.types import DisplayName
+from app.queries.user_query import UserQuery
+
+
+async def test_resolve_users_cache():
+    user = await UserQuery.find_by_display_name(DisplayName('user1'))
+    assert user is not None
+    user_id = user['id']
+
+    first = [{'user_id': user_id}]
+    await UserQuery.resolve_users(first)
+    assert first[0]['user']['display_name'] == 'user1'
+
+    # Cached rows are shared until invalidated
+    second = [{'user_id': user_id}]
+    await UserQuery.resolve_users(second)
+    assert second[0]['user'] is first[0]['user']
+
+    UserQuery.invalidate_user_display(user_id)
+    third = [{'user_id': user_id}]
+    await UserQuery.resolve_users(third)
+    assert third[0]['user'] is not first[0]['user']
+    assert third[0]['user'] == first[0]['user']
@@ -57,6 +57,28 @@ async def test_create_node_with_tags(changeset_id: ChangesetId):
     assert_model(elements[0], element | {'typed_id': typed_id})
 
 
+async def test_create_node_with_special_tags(changeset_id: ChangesetId):
+    # Arrange
+    element: ElementInit = {
+        'changeset_id': changeset_id,
+        'typed_id': typed_element_id('node', ElementId(-1)),
+        'version': 1,
+        'visible': True,
+        'tags': {'name': 'Tab\tQuote"Back\\slash', 'name:zh': '咖啡馆', 'note': ''},
+        'point': Point(-179.5, 89.25),
+        'members': None,
+        'members_roles': None,
+    }
+
+    # Act
+    assigned_ref_map = await OptimisticDiff.run([element])
+
+    # Assert
+    typed_id = assigned_ref_map[typed_element_id('node', ElementId(-1))][0]
+    elements = await ElementQuery.find_by_refs([typed_id], limit=1)
+    assert_model(elements[0], element | {'typed_id': typed_id})
+
+
 async def test_create_multiple_nodes(changeset_id: ChangesetId):
     # Arrange
     nodes: list[ElementInit] = [
@@ -0,0 +1,42 @@
+from asyncio import gather, sleep
+
+import pytest
+
+from app.services.cache_service import CacheContext, CacheService
+from speedup import buffered_rand_storage_key
+
+_CONTEXT = CacheContext('test')
+
+
+async def test_get_single_flight():
+    key = buffered_rand_storage_key()
+    calls = 0
+
+    async def factory():
+        nonlocal calls
+        calls += 1
+        await sleep(0.05)
+        return b'value'
+
+    results = await gather(
+        *(CacheService.get(key, _CONTEXT, factory) for _ in range(20))
+    )
+    assert results == [b'value'] * 20
+    assert calls == 1, 'Concurrent callers must share one generation'
+
+
+async def test_get_single_flight_error():
+    key = buffered_rand_storage_key()
+
+    async def factory():
+        await sleep(0.05)
+        raise ValueError('boom')
+
+    results = await gather(
+        *(CacheService.get(key, _CONTEXT, factory) for _ in range(3)),
+        return_exceptions=True,
+    )
+    assert all(isinstance(r, ValueError) for r in results)
+
+    # Failures are not cached
+    assert await CacheService.get(key, _CONTEXT, lambda: sleep(0, b'ok')) == b'ok'
@@ -1,11 +1,15 @@
 import pytest
-from shapely import LineString, Point, box
+from shapely import LineString, Point, Polygon, box, get_srid
 
+from app.lib.geo import node_location_store
 from app.models.db.element import ElementInit
-from app.models.element import ElementId
+from app.models.element import ElementId, TypedElementId
 from app.models.types import ChangesetId
 from app.queries.element_spatial_query import ElementSpatialQuery
-from app.services.element_spatial_service import ElementSpatialService
+from app.services.element_spatial_service import (
+    ElementSpatialService,
+    _build_way_geoms,
+)
 from app.services.optimistic_diff import OptimisticDiff
 from app.validators.geometry import validate_geometry
 from speedup import typed_element_id
@@ -224,3 +228,112 @@ async def test_element_spatial_cascading_updates(changeset_id: ChangesetId):
     assert way_id not in result_ids_deleted, 'Way not deleted'
     assert relation1_id not in result_ids_deleted, 'Relation 1 not deleted'
     assert relation2_id not in result_ids_deleted, 'Relation 2 not deleted'
+
+
+@pytest.mark.extended
+async def test_element_spatial_relation_cycle(changeset_id: ChangesetId):
+    """
+    Test element_spatial processing of relations that reference each other.
+    Structure: node -> relation1 <-> relation2
+    """
+    elements: list[ElementInit] = [
+        {
+            'changeset_id': changeset_id,
+            'typed_id': typed_element_id('node', ElementId(-1)),
+            'version': 1,
+            'visible': True,
+            'tags': {'name': 'Node'},
+            'point': Point(20, 20),
+            'members': None,
+            'members_roles': None,
+        },
+        {
+            'changeset_id': changeset_id,
+            'typed_id': typed_element_id('relation', ElementId(-1)),
+            'version': 1,
+            'visible': True,
+            'tags': {'type': 'collection', 'name': 'Relation 1'},
+            'point': None,
+            'members': [typed_element_id('node', ElementId(-1))],
+            'members_roles': [''],
+        },
+        {
+            'changeset_id': changeset_id,
+            'typed_id': typed_element_id('relation', ElementId(-2)),
+            'version': 1,
+            'visible': True,
+            'tags': {'type': 'collection', 'name': 'Relation 2'},
+            'point': None,
+            'members': [typed_element_id('relation', ElementId(-1))],
+            'members_roles': [''],
+        },
+    ]
+
+    assigned_ref_map = await OptimisticDiff.run(elements)
+    node_id = assigned_ref_map[typed_element_id('node', ElementId(-1))][0]
+    relation1_id = assigned_ref_map[typed_element_id('relation', ElementId(-1))][0]
+    relation2_id = assigned_ref_map[typed_element_id('relation', ElementId(-2))][0]
+
+    # Close the cycle: relation1 -> relation2
+    relation1_update: ElementInit = {
+        'changeset_id': changeset_id,
+        'typed_id': relation1_id,
+        'version': 2,
+        'visible': True,
+        'tags': {'type': 'collection', 'name': 'Relation 1'},
+        'point': None,
+        'members': [node_id, relation2_id],
+        'members_roles': ['', ''],
+    }
+
+    await OptimisticDiff.run([relation1_update])
+    await ElementSpatialService.force_process()
+
+    # Assert: Cycle members are forced through with the node geometry
+    search_area = validate_geometry(box(19.999, 19.999, 20.001, 20.001))
+    results = await ElementSpatialQuery.query_features(search_area)
+    results_by_id = {r['typed_id']: r for r in results}
+
+    assert relation1_id in results_by_id, 'Relation 1 not found'
+    assert relation2_id in results_by_id, 'Relation 2 not found'
+    assert results_by_id[relation1_id]['geom'].equals(Point(20, 20)), (
+        'Relation 1 geometry incorrect'
+    )
+    assert results_by_id[relation2_id]['geom'].equals(Point(20, 20)), (
+        'Relation 2 geometry incorrect'
+    )
+
+
+async def test_build_way_geoms(tmp_path):
+    await node_location_store._open(tmp_path / 'nodes.bin')
+    try:
+        node_location_store._apply([
+            (TypedElementId(1), Point(0, 0)),
+            (TypedElementId(2), Point(1, 0)),
+            (TypedElementId(3), Point(1, 1)),
+            (TypedElementId(4), Point(1, 1)),
+            (TypedElementId(5), None),
+        ])
+        geoms = _build_way_geoms([
+            [TypedElementId(1), TypedElementId(2), TypedElementId(3)],
+            [
+                TypedElementId(1),
+                TypedElementId(2),
+                TypedElementId(3),
+                TypedElementId(1),
+            ],
+            [TypedElementId(1), TypedElementId(5), TypedElementId(6)],
+            [TypedElementId(3), TypedElementId(4)],
+            [TypedElementId(1), TypedElementId(1), TypedElementId(2)],
+            None,
+        ])
+    finally:
+        node_location_store._close()
+
+    assert geoms[0] == LineString([(0, 0), (1, 0), (1, 1)])
+    assert geoms[1] == Polygon([(0, 0), (1, 0), (1, 1), (0, 0)])
+    assert geoms[2] is None
+    assert geoms[3] == LineString([(1, 1), (1, 1)])
+    assert geoms[4] == LineString([(0, 0), (1, 0)])
+    assert geoms[5] is None
+    assert get_srid(geoms[0]) == 4326
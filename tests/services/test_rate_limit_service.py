@@ -0,0 +1,36 @@
+import pytest
+
+from app.db import db_fetchval
+from app.services.rate_limit_service import RateLimitService, _sync
+from speedup import buffered_rand_urlsafe
+
+
+async def _db_usage(key: str):
+    return await db_fetchval(
+        float, t'SELECT usage::float8 FROM rate_limit WHERE key = {key}'
+    )
+
+
+async def test_rate_limit_headers():
+    key = f'test:{buffered_rand_urlsafe(16)}'
+    headers = await RateLimitService.update(key, 1, 10)
+    assert headers == {
+        'RateLimit': '"default";r=9;t=360',
+        'RateLimit-Policy': '"default";q=10;w=3600',
+    }
+
+    headers = await RateLimitService.update(key, 2, 10)
+    assert headers['RateLimit'] == '"default";r=7;t=1080'
+
+
+async def test_rate_limit_sync():
+    key = f'test:{buffered_rand_urlsafe(16)}'
+    await RateLimitService.update(key, 2, 10)
+    await RateLimitService.update(key, 3, 10)
+
+    await _sync()
+    assert await _db_usage(key) == pytest.approx(5, abs=0.01)
+
+    await RateLimitService.update(key, 1, 10)
+    await _sync()
+    assert await _db_usage(key) == pytest.approx(6, abs=0.01)
@@ -0,0 +1,61 @@
+from asyncio import gather
+
+from psycopg.errors import DivisionByZero
+
+from app.db import DBLoader, db_batch, db_fetchcol, db_fetchone, db_fetchval
+
+
+async def test_db_batch_shares_connection():
+    with db_batch():
+        pids = await gather(
+            db_fetchval(int, t'SELECT pg_backend_pid()'),
+            db_fetchval(int, t'SELECT pg_backend_pid()'),
+            db_fetchval(int, t'SELECT pg_backend_pid()'),
+        )
+    assert len(set(pids)) == 1
+
+
+async def test_db_batch_results():
+    with db_batch():
+        row, col, missing = await gather(
+            db_fetchone(dict, t'SELECT 1 AS a, 2 AS b'),
+            db_fetchcol(int, t'SELECT generate_series(1, 5)', limit=3),
+            db_fetchval(int, t'SELECT 1 WHERE FALSE'),
+        )
+    assert row == {'a': 1, 'b': 2}
+    assert col == [1, 2, 3]
+    assert missing is None
+
+
+async def test_db_batch_isolates_errors():
+    with db_batch():
+        before, failed, after = await gather(
+            db_fetchval(int, t'SELECT 1'),
+            db_fetchval(int, t'SELECT 1 / 0'),
+            db_fetchval(int, t'SELECT 3'),
+            return_exceptions=True,
+        )
+    assert before == 1
+    assert isinstance(failed, DivisionByZero)
+    assert after == 3
+
+
+async def test_db_loader_coalesces_and_memoizes():
+    calls: list[list[int]] = []
+
+    async def load(keys: list[int]):
+        calls.append(keys)
+        return [(key, key * 10) for key in keys if key != 3]
+
+    loader = DBLoader[int, int](load)
+    with db_batch():
+        first, second = await gather(
+            loader.load_many([1, 2]),
+            loader.load_many([2, 3]),
+        )
+        third = await loader.load_many([1, 3, 4])
+
+    assert first == {1: 10, 2: 20}
+    assert second == {2: 20}
+    assert third == {1: 10, 4: 40}
+    assert calls == [[1, 2, 3], [4]]
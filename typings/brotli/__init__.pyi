@@ -22,7 +22,10 @@ class Compressor:
 
 class Decompressor:
     def __init__(self): ...
-    def process(self, string: bytes) -> bytes: ...
+    def process(
+        self, string: bytes, output_buffer_limit: int | None = None
+    ) -> bytes: ...
+    def can_accept_more_data(self) -> bool: ...
     def is_finished(self) -> bool: ...
 
 # Functions